@@ -0,0 +1,265 @@
+#include "Analyzer.h"
+
+#include <algorithm>
+#include <map>
+
+#include "vCPU.h"
+
+namespace {
+    // Index register where a block starts, as far as it can be worked out.
+    struct IndexValue {
+        enum State : uint8_t { Unset, Known, Unknown };
+
+        State state = Unset;
+        uint16_t value = 0;
+
+        // Combine with the value arriving over another edge, false if that changes nothing.
+        bool merge(const IndexValue other) {
+            if (other.state == Unset || state == Unknown || (state == Known && other.state == Known &&
+                                                               value == other.value)) {
+                return false;
+            }
+            if (state == Unset) {
+                *this = other;
+            } else {
+                state = Unknown;
+            }
+            return true;
+        }
+    };
+
+    template <typename T>
+    void sortUnique(std::vector<T> &values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+    }
+}
+
+Analysis Analyzer::analyze(const uint8_t *rom, const size_t size, const Profile profile) {
+    Analysis analysis;
+    switch (profile) {
+        case Profile::Modern: analysis = run<Chip8, ModernQuirks>(rom, size); break;
+        case Profile::Vip: analysis = run<Chip8, VipQuirks>(rom, size); break;
+        case Profile::Chip48: analysis = run<Chip8, Chip48Quirks>(rom, size); break;
+        case Profile::SuperChip: analysis = run<SuperChip, SuperChipQuirks>(rom, size); break;
+        case Profile::XoChip: analysis = run<XoChip, XoChipQuirks>(rom, size); break;
+    }
+    analysis.profile = profile;
+    return analysis;
+}
+
+template <typename Machine, typename Quirks>
+Analysis Analyzer::run(const uint8_t *rom, const size_t size) {
+    using CPU = BasicCPU<Machine, Quirks>;
+    using Op = typename CPU::Op;
+    using EdgeKind = Analysis::EdgeKind;
+
+    Analysis analysis;
+    analysis.size = size;
+
+    // Memory as loadROM() leaves it, as far as code is concerned.
+    std::vector<uint8_t> memory(CPU::MEMORY);
+    const unsigned int romEnd = CPU::START_ADDRESS + static_cast<unsigned int>(
+                                    std::min<size_t>(size, CPU::MEMORY - CPU::START_ADDRESS));
+    std::copy(rom, rom + (romEnd - CPU::START_ADDRESS), memory.begin() + CPU::START_ADDRESS);
+
+    const auto word = [&memory](const unsigned int address) {
+        return static_cast<uint16_t>(memory[address & CPU::ADDRESS_MASK] << 8u |
+                                     memory[(address + 1) & CPU::ADDRESS_MASK]);
+    };
+    const auto next = [&word](const unsigned int address) {
+        const unsigned int length = Machine::XO && word(address) == 0xF000 ? 4 : 2;
+        return static_cast<uint16_t>((address + length) & CPU::ADDRESS_MASK);
+    };
+    const auto isSkip = [](const Op op) {
+        return op == Op::OP_3xnn || op == Op::OP_4xnn || op == Op::OP_5xy0 || op == Op::OP_9xy0 ||
+               op == Op::OP_Ex9E || op == Op::OP_ExA1;
+    };
+
+    // --- Reachable instructions ---
+
+    struct Found {
+        Analysis::Instruction instruction;
+        bool ends; // Ends a block whatever follows.
+        std::vector<Analysis::Edge> successors;
+    };
+    std::map<uint16_t, Found> found;
+    std::vector<uint8_t> leader(CPU::MEMORY);
+    std::vector<uint8_t> fallsInto(CPU::MEMORY);
+    std::vector<uint16_t> work{CPU::START_ADDRESS};
+    leader[CPU::START_ADDRESS] = 1;
+
+    while (!work.empty()) {
+        const uint16_t address = work.back();
+        work.pop_back();
+        if (found.contains(address)) {
+            continue;
+        }
+        if (address < CPU::START_ADDRESS || address + 2u > romEnd) {
+            analysis.outside.push_back(address);
+            continue;
+        }
+
+        const uint16_t opcode = word(address);
+        const auto ins = CPU::decode(opcode);
+        const uint16_t after = next(address);
+        Found &f = found[address];
+        f.instruction = {address, opcode, word(address + 2)};
+        f.ends = true;
+
+        if (isSkip(ins.op)) {
+            f.successors = {{after, EdgeKind::Next}, {next(after), EdgeKind::Skip}};
+        } else {
+            switch (ins.op) {
+                case Op::OP_1nnn: f.successors = {{ins.nnn(), EdgeKind::Jump}}; break;
+                case Op::OP_2nnn: f.successors = {{ins.nnn(), EdgeKind::Call}, {after, EdgeKind::Return}}; break;
+                case Op::OP_Bnnn: analysis.computedJumps.push_back(address); break;
+                case Op::OP_00EE:
+                case Op::OP_00FD:
+                    break;
+                default:
+                    f.ends = false;
+                    f.successors = {{after, EdgeKind::Next}};
+                    ++fallsInto[after];
+                    break;
+            }
+        }
+
+        // The busy-waits vCPU::run() skips.
+        if (ins.op == Op::OP_Fx07) {
+            const uint16_t opcodes[4] = {opcode, word(address + 2), word(address + 4), word(address + 6)};
+            if (CPU::isDelayWait(address, opcodes)) {
+                analysis.delayWaits.push_back(address);
+            }
+        }
+
+        for (const auto &edge : f.successors) {
+            if (f.ends) {
+                leader[edge.target] = 1;
+            }
+            work.push_back(edge.target);
+        }
+    }
+
+    // --- Basic blocks ---
+
+    std::vector<uint8_t> code(CPU::MEMORY);
+    for (const auto &[address, f] : found) {
+        for (unsigned int a = address; a != next(address); a = (a + 1) & CPU::ADDRESS_MASK) {
+            code[a] = 1;
+        }
+        // Reached other than by falling through from a single instruction, so something else enters here.
+        if (fallsInto[address] > 1) {
+            leader[address] = 1;
+        }
+    }
+    analysis.instructions = static_cast<unsigned int>(found.size());
+    analysis.codeBytes = static_cast<unsigned int>(std::count(code.begin(), code.end(), 1));
+
+    std::map<uint16_t, size_t> blockAt;
+    for (const auto &[start, first] : found) {
+        if (!leader[start]) {
+            continue;
+        }
+
+        Analysis::Block block{start, start, {}, {}};
+        for (auto f = found.find(start);;) {
+            block.instructions.push_back(f->second.instruction);
+            block.end = next(f->first);
+            if (f->second.ends) {
+                block.successors = f->second.successors;
+                break;
+            }
+            f = found.find(block.end);
+            if (f == found.end() || leader[block.end]) {
+                block.successors = {{block.end, EdgeKind::Next}};
+                break;
+            }
+        }
+
+        std::erase_if(block.successors, [&found](const Analysis::Edge &edge) { return !found.contains(edge.target); });
+        blockAt[start] = analysis.blocks.size();
+        analysis.blocks.push_back(std::move(block));
+    }
+
+    // --- Index register and stores ---
+
+    // Forward dataflow over the blocks. A subroutine may leave the index anywhere, so it is unknown after a call.
+    const auto step = [](IndexValue &index, const typename CPU::Instruction ins, const uint16_t operand) {
+        const auto loadStore = [&index, &ins] {
+            if (index.state == IndexValue::Known && Quirks::LOAD_STORE != LoadStore::Unchanged) {
+                index.value = static_cast<uint16_t>(
+                    (index.value + ins.x + (Quirks::LOAD_STORE == LoadStore::AddXPlusOne)) & CPU::ADDRESS_MASK);
+            }
+        };
+        switch (ins.op) {
+            case Op::OP_Annn: index = {IndexValue::Known, ins.nnn()}; break;
+            case Op::OP_F000: index = {IndexValue::Known, static_cast<uint16_t>(operand & CPU::ADDRESS_MASK)}; break;
+            case Op::OP_Fx1E:
+            case Op::OP_Fx29:
+            case Op::OP_Fx30:
+                index.state = IndexValue::Unknown;
+                break;
+            case Op::OP_Fx55:
+            case Op::OP_Fx65:
+                loadStore();
+                break;
+            default: break;
+        }
+    };
+
+    std::vector<IndexValue> entry(analysis.blocks.size());
+    std::vector<size_t> pending;
+    if (const auto start = blockAt.find(CPU::START_ADDRESS); start != blockAt.end()) {
+        entry[start->second] = {IndexValue::Known, 0};
+        pending.push_back(start->second);
+    }
+    while (!pending.empty()) {
+        const size_t b = pending.back();
+        pending.pop_back();
+
+        IndexValue index = entry[b];
+        for (const auto &instruction : analysis.blocks[b].instructions) {
+            step(index, CPU::decode(instruction.opcode), instruction.operand);
+        }
+        for (const auto &edge : analysis.blocks[b].successors) {
+            const IndexValue arriving = edge.kind == EdgeKind::Return ? IndexValue{IndexValue::Unknown} : index;
+            if (const size_t target = blockAt.at(edge.target); entry[target].merge(arriving)) {
+                pending.push_back(target);
+            }
+        }
+    }
+
+    for (size_t b = 0; b < analysis.blocks.size(); ++b) {
+        IndexValue index = entry[b];
+        for (const auto &instruction : analysis.blocks[b].instructions) {
+            const auto ins = CPU::decode(instruction.opcode);
+            unsigned int length = 0;
+            switch (ins.op) {
+                case Op::OP_Fx33: length = 3; break;
+                case Op::OP_Fx55: length = ins.x + 1u; break;
+                case Op::OP_5xy2: length = (ins.x > ins.y ? ins.x - ins.y : ins.y - ins.x) + 1u; break;
+                default: break;
+            }
+
+            if (length > 0 && index.state != IndexValue::Known) {
+                analysis.unknownWrites.push_back(instruction.address);
+            } else if (length > 0) {
+                bool hitsCode = false;
+                for (unsigned int i = 0; i < length; ++i) {
+                    hitsCode |= code[(index.value + i) & CPU::ADDRESS_MASK] != 0;
+                }
+                if (hitsCode) {
+                    analysis.codeWrites.push_back({instruction.address, index.value, static_cast<uint8_t>(length)});
+                }
+            }
+
+            step(index, ins, instruction.operand);
+        }
+    }
+
+    sortUnique(analysis.computedJumps);
+    sortUnique(analysis.delayWaits);
+    sortUnique(analysis.outside);
+    return analysis;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RomDatabase.h"
+
+// Static structure of a ROM: the code reachable from START_ADDRESS by following jumps, calls, returns and skips,
+// split into basic blocks, plus the things that get in the way of handling it ahead of time.
+struct Analysis {
+    // Bumped whenever results for the same ROM change, so cached results from other versions are not reused.
+    static constexpr unsigned int VERSION = 1;
+
+    enum class EdgeKind : uint8_t {
+        Next, // Falls through into the next block.
+        Jump, // 1nnn.
+        Skip, // Taken skip, over the next instruction.
+        Call, // 2nnn into the subroutine.
+        Return // From a 2nnn to the instruction after it, once the subroutine returns.
+    };
+
+    struct Edge {
+        uint16_t target;
+        EdgeKind kind;
+    };
+
+    struct Instruction {
+        uint16_t address;
+        uint16_t opcode;
+        uint16_t operand; // The word after it, the address of F000 nnnn.
+    };
+
+    // Straight-line run entered only at its first instruction and left only after its last.
+    struct Block {
+        uint16_t start;
+        uint16_t end; // Address after the last instruction.
+        std::vector<Instruction> instructions;
+        std::vector<Edge> successors; // None after 00EE, Bnnn, 00FD or running off the ROM.
+    };
+
+    // Fx33, Fx55 or 5xy2 storing length bytes from begin.
+    struct Write {
+        uint16_t address;
+        uint16_t begin;
+        uint8_t length;
+    };
+
+    Profile profile = Profile::Modern;
+    size_t size = 0; // ROM bytes.
+    unsigned int instructions = 0; // Reachable instructions.
+    unsigned int codeBytes = 0; // ROM bytes covered by them.
+
+    std::vector<Block> blocks; // By start address.
+    std::vector<uint16_t> computedJumps; // Bnnn, whose targets depend on a register.
+    std::vector<Write> codeWrites; // Stores into reachable code, i.e. self-modifying code.
+    std::vector<uint16_t> unknownWrites; // Stores whose index could not be worked out, which might hit code.
+    std::vector<uint16_t> delayWaits; // Fx07 busy-waits on the delay timer, the ones run() skips.
+    std::vector<uint16_t> outside; // Jump, call and fall-through targets outside the ROM.
+};
+
+// Builds an Analysis with the instruction decoding of the profile's BasicCPU.
+class Analyzer {
+public:
+    static Analysis analyze(const uint8_t *rom, size_t size, Profile profile);
+
+private:
+    template <typename Machine, typename Quirks>
+    static Analysis run(const uint8_t *rom, size_t size);
+};
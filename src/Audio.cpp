@@ -0,0 +1,53 @@
+#include "Audio.h"
+
+namespace {
+    constexpr unsigned int QUEUED_BUFFERS = 3; // Buffers SFML keeps queued ahead of playback.
+}
+
+Audio::Audio() {
+    initialize(1, ToneGenerator::SAMPLE_RATE);
+    setProcessingInterval(sf::milliseconds(1));
+}
+
+Audio::~Audio() {
+    stop(); // The stream thread calls onGetData, it has to finish before the members go.
+}
+
+bool Audio::onGetData(Chunk &data) {
+    const auto start = std::chrono::steady_clock::now();
+
+    // Once the gap between callbacks is longer than the queued audio, playback ran dry.
+    constexpr auto queued = std::chrono::microseconds(1'000'000ull * BUFFER_SAMPLES * QUEUED_BUFFERS /
+                                                      ToneGenerator::SAMPLE_RATE);
+    if (mLastCallback.time_since_epoch().count() != 0 && start - mLastCallback > queued) {
+        mUnderruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    mLastCallback = start;
+
+    tone.fill(mBuffer, BUFFER_SAMPLES);
+    data.samples = mBuffer;
+    data.sampleCount = BUFFER_SAMPLES;
+
+    const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    mCallbacks.fetch_add(1, std::memory_order_relaxed);
+    mCallbackNanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+    if (elapsed > mWorstNanoseconds.load(std::memory_order_relaxed)) {
+        mWorstNanoseconds.store(elapsed, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void Audio::onSeek(sf::Time) {
+    // A generated tone has no position.
+}
+
+Audio::Stats Audio::takeStats() {
+    Stats stats;
+    stats.callbacks = mCallbacks.exchange(0);
+    stats.underruns = mUnderruns.exchange(0);
+    const auto total = static_cast<double>(mCallbackNanoseconds.exchange(0));
+    stats.averageMicroseconds = stats.callbacks > 0 ? total / stats.callbacks / 1000.0 : 0;
+    stats.maxMicroseconds = static_cast<double>(mWorstNanoseconds.exchange(0)) / 1000.0;
+    return stats;
+}
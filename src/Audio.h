@@ -0,0 +1,45 @@
+#pragma once
+
+#include <SFML/Audio.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "Tone.h"
+
+// Streams the ToneGenerator to the sound card in small buffers.
+// SFML keeps three buffers queued, so with 5ms buffers and a 1ms processing interval a gate change is heard
+// within roughly 16ms.
+class Audio : public sf::SoundStream {
+public:
+    static constexpr unsigned int BUFFER_SAMPLES = ToneGenerator::SAMPLE_RATE / 200; // 5ms.
+
+    Audio();
+    ~Audio() override;
+
+    ToneGenerator tone;
+
+    // Callback stats since the last call.
+    struct Stats {
+        int callbacks = 0;
+        int underruns = 0; // Callbacks that came too late to keep the queue from running dry.
+        double averageMicroseconds = 0;
+        double maxMicroseconds = 0;
+    };
+
+    Stats takeStats();
+
+protected:
+    bool onGetData(Chunk &data) override;
+    void onSeek(sf::Time timeOffset) override;
+
+private:
+    int16_t mBuffer[BUFFER_SAMPLES]{};
+
+    std::chrono::steady_clock::time_point mLastCallback{};
+    std::atomic<int> mCallbacks{0};
+    std::atomic<int> mUnderruns{0};
+    std::atomic<int64_t> mCallbackNanoseconds{0};
+    std::atomic<int64_t> mWorstNanoseconds{0};
+};
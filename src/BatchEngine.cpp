@@ -0,0 +1,45 @@
+#include "BatchEngine.h"
+
+#include <cstring>
+
+#include "Hash.h"
+
+BatchEngine::BatchEngine(const size_t instances, const vCPU &prototype, ThreadPool &pool) :
+    pool(pool),
+    instances(instances, prototype),
+    outputs(instances)
+{
+}
+
+void BatchEngine::step(const uint16_t *keys, const unsigned int cycles) {
+    pool.parallelFor(instances.size(), GRAIN, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            vCPU &cpu = instances[i];
+
+            if (keys != nullptr) {
+                for (unsigned int k = 0; k < 16; ++k) {
+                    cpu.keypad[k] = keys[i] >> k & 1u;
+                }
+            }
+
+            cpu.run(cycles);
+
+            Output &out = outputs[i];
+            std::memcpy(out.video, cpu.video, sizeof(out.video));
+            out.hash = stateHash(cpu);
+            out.reward = reward ? reward(cpu) : 0.0f;
+            out.cycles = cycles;
+        }
+    });
+}
+
+uint64_t BatchEngine::stateHash(const vCPU &cpu) {
+    uint64_t h = hash64(cpu.registers, sizeof(cpu.registers));
+    const uint16_t words[3] = {cpu.index, cpu.pc, static_cast<uint16_t>(cpu.sp | cpu.delayTimer() << 8u)};
+    h = hash64(words, sizeof(words), h);
+    const uint8_t soundTimer = cpu.soundTimer();
+    h = hash64(&soundTimer, sizeof(soundTimer), h);
+    h = hash64(cpu.stack, sizeof(cpu.stack), h);
+    h = hash64(cpu.memory, sizeof(cpu.memory), h);
+    return hash64(cpu.video, sizeof(cpu.video), h);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "vCPU.h"
+
+// Runs many independent vCPU instances in fixed cycle quanta across a thread pool.
+// Every step takes one keypad mask per instance and leaves one Output record per instance in a single
+// contiguous buffer, ready to hand to a training loop or regression checker.
+class BatchEngine {
+public:
+    // Per-instance result of a step.
+    struct Output {
+        uint64_t video[32]; // Display rows, see vCPU::video.
+        uint64_t hash; // Hash of registers, index, pc, stack, timers, memory and display.
+        float reward; // Value of the reward function, 0 without one.
+        uint32_t cycles; // Cycles the instance ran this step.
+    };
+
+    // Every instance starts as a copy of prototype (typically with a ROM already loaded).
+    BatchEngine(size_t instances, const vCPU &prototype, ThreadPool &pool);
+
+    // Run every instance for the given cycles. keys holds one mask per instance, bit i set while key i is down,
+    // and may be null to keep the current keypads.
+    void step(const uint16_t *keys, unsigned int cycles);
+
+    [[nodiscard]] size_t size() const { return instances.size(); }
+    [[nodiscard]] const Output *output() const { return outputs.data(); }
+
+    vCPU &instance(const size_t i) { return instances[i]; }
+    [[nodiscard]] const vCPU &instance(const size_t i) const { return instances[i]; }
+
+    // Optional reward, evaluated for every instance at the end of a step.
+    std::function<float(const vCPU &)> reward;
+
+    static uint64_t stateHash(const vCPU &cpu);
+
+private:
+    static constexpr size_t GRAIN = 16; // Instances per work item.
+
+    ThreadPool &pool;
+    std::vector<vCPU> instances;
+    std::vector<Output> outputs;
+};
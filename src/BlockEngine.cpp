@@ -0,0 +1,493 @@
+#include "BlockEngine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+BlockEngine::BlockEngine(vCPU &cpu) :
+    cpu(cpu)
+{
+    std::fill(std::begin(blockAt), std::end(blockAt), -1);
+
+    // Writes made before the engine was attached cannot affect blocks that do not exist yet.
+    cpu.writtenBegin = 0xFFFF;
+    cpu.writtenEnd = 0;
+}
+
+void BlockEngine::run(unsigned long long cycles) {
+    while (cycles > 0) {
+        cycles -= dispatch(cycles, true);
+    }
+}
+
+void BlockEngine::flush() {
+    blocks.clear();
+    freeBlocks.clear();
+    std::fill(std::begin(blockAt), std::end(blockAt), -1);
+    std::fill(std::begin(coverage), std::end(coverage), 0);
+}
+
+unsigned long long BlockEngine::dispatch(const unsigned long long budget, const bool chain) {
+    syncWrites();
+
+    const Block *block = lookup(cpu.pc);
+    if (block == nullptr || block->length > budget) {
+        // Odd addresses, the end of memory and budget tails go through the interpreter.
+        cpu.run(1);
+        syncWrites();
+        return 1;
+    }
+
+    // A block opening with Fx07 may be a busy-wait on the delay timer, which the vCPU can skip ahead through.
+    if (block->steps.front().ins.op == vCPU::Op::OP_Fx07) {
+        if (const unsigned long long skipped = cpu.skipDelayWait(block->steps.front().ins, budget); skipped > 0) {
+            return skipped;
+        }
+    }
+
+    using Quirks = Chip8::DefaultQuirks;
+    uint8_t *const V = cpu.registers;
+    const uint64_t startCycle = cpu.cycleCount;
+    unsigned long long executed = 0; // Cycles of the blocks before this one.
+    const Step *step;
+
+    // cycleCount is only brought up to date before the steps that can read it: timer instructions and handlers.
+#define CHIP8_SYNC_CYCLES() cpu.cycleCount = startCycle + executed + step->offset
+
+#if defined(__GNUC__)
+    // Threaded like vCPU::run(), each step ending in its own jump to the next. BlockEnd marks the end of a block.
+    static void *const handlers[] = {
+        &&step_NULL, &&step_call, &&step_00EE, &&step_1nnn, &&step_2nnn, &&step_3xnn, &&step_4xnn,
+        &&step_5xy0, &&step_6xnn, &&step_7xnn, &&step_8xy0, &&step_8xy1, &&step_8xy2, &&step_8xy3, &&step_8xy4,
+        &&step_8xy5, &&step_8xy6, &&step_8xy7, &&step_8xyE, &&step_9xy0, &&step_Annn, &&step_call, &&step_call,
+        &&step_call, &&step_Ex9E, &&step_ExA1, &&step_Fx07, &&step_call, &&step_Fx15, &&step_Fx18, &&step_Fx1E,
+        &&step_call, &&step_call, &&step_call, &&step_call,
+        &&step_call, &&step_call, &&step_call, &&step_call, &&step_call, &&step_call, &&step_call, &&step_call,
+        &&step_call, &&step_call, &&step_call, &&step_call, &&step_call, &&step_call, &&step_call, &&step_call,
+        &&step_end,
+    };
+    static_assert(std::size(handlers) == static_cast<size_t>(vCPU::Op::BlockEnd) + 1);
+
+#define CHIP8_STEP(name) step_##name:
+#define CHIP8_STEP_ANY() step_call:
+#define CHIP8_STEP_END() step_end:
+#define CHIP8_NEXT_STEP()                                       \
+    ++step;                                                     \
+    goto *handlers[static_cast<uint8_t>(step->ins.op)]
+
+enter:
+    cpu.pc = block->end;
+    step = block->steps.data();
+    goto *handlers[static_cast<uint8_t>(step->ins.op)];
+    {
+#else
+#define CHIP8_STEP(name) case vCPU::Op::OP_##name:
+#define CHIP8_STEP_ANY() default:
+#define CHIP8_STEP_END() case vCPU::Op::BlockEnd:
+#define CHIP8_NEXT_STEP()                                       \
+    ++step;                                                     \
+    continue
+
+enter:
+    cpu.pc = block->end;
+    step = block->steps.data();
+    for (;;) {
+        switch (step->ins.op) {
+#endif
+        // Only the final step of a block reads or changes pc, and it expects pc to be past itself.
+        CHIP8_STEP(00EE)
+            --cpu.sp;
+            cpu.pc = cpu.stack[cpu.sp & 0xFu];
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(1nnn)
+            cpu.pc = step->ins.nnn();
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(2nnn)
+            cpu.stack[cpu.sp & 0xFu] = cpu.pc;
+            ++cpu.sp;
+            cpu.pc = step->ins.nnn();
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(NULL)
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(3xnn)
+            if (V[step->ins.x] == step->ins.nn) {
+                goto step_skip;
+            }
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(4xnn)
+            if (V[step->ins.x] != step->ins.nn) {
+                goto step_skip;
+            }
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(5xy0)
+            if (V[step->ins.x] == V[step->ins.y]) {
+                goto step_skip;
+            }
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(9xy0)
+            if (V[step->ins.x] != V[step->ins.y]) {
+                goto step_skip;
+            }
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(Ex9E)
+            if (cpu.keypad[V[step->ins.x] & 0xFu] != 0) {
+                goto step_skip;
+            }
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(ExA1)
+            if (cpu.keypad[V[step->ins.x] & 0xFu] == 0) {
+                goto step_skip;
+            }
+            CHIP8_NEXT_STEP();
+        step_skip:
+            // The instruction skipped is the next step when it was compiled into the block, which then costs a
+            // cycle less, or else the one at pc. No four-byte instructions to skip on plain CHIP-8.
+            if (step->overStep) {
+                executed -= step[1].cycles;
+                ++step;
+            } else {
+                cpu.pc += 2;
+            }
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(6xnn)
+            V[step->ins.x] = step->ins.nn;
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(7xnn)
+            V[step->ins.x] += step->ins.nn;
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(8xy0)
+            V[step->ins.x] = V[step->ins.y];
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(8xy1) CHIP8_STEP(8xy2)
+        CHIP8_STEP(8xy3) {
+            const vCPU::Instruction ins = step->ins;
+            V[ins.x] = ins.op == vCPU::Op::OP_8xy1 ? V[ins.x] | V[ins.y] :
+                       ins.op == vCPU::Op::OP_8xy2 ? V[ins.x] & V[ins.y] : V[ins.x] ^ V[ins.y];
+            if constexpr (Quirks::LOGIC_RESETS_VF) {
+                V[0xF] = 0;
+            }
+            CHIP8_NEXT_STEP();
+        }
+        CHIP8_STEP(8xy4) {
+            const unsigned int sum = V[step->ins.x] + V[step->ins.y];
+            V[step->ins.x] = static_cast<uint8_t>(sum);
+            V[0xF] = sum > 255u ? 1 : 0; // VF last, so the flag wins when X is F.
+            CHIP8_NEXT_STEP();
+        }
+        CHIP8_STEP(8xy5) {
+            const uint8_t noBorrow = V[step->ins.x] >= V[step->ins.y] ? 1 : 0;
+            V[step->ins.x] -= V[step->ins.y];
+            V[0xF] = noBorrow;
+            CHIP8_NEXT_STEP();
+        }
+        CHIP8_STEP(8xy7) {
+            const uint8_t noBorrow = V[step->ins.y] >= V[step->ins.x] ? 1 : 0;
+            V[step->ins.x] = V[step->ins.y] - V[step->ins.x];
+            V[0xF] = noBorrow;
+            CHIP8_NEXT_STEP();
+        }
+        CHIP8_STEP(8xy6) CHIP8_STEP(8xyE) {
+            const vCPU::Instruction ins = step->ins;
+            const uint8_t source = Quirks::SHIFT_VY ? V[ins.y] : V[ins.x];
+            const bool right = ins.op == vCPU::Op::OP_8xy6;
+            V[ins.x] = right ? source >> 1u : static_cast<uint8_t>(source << 1u);
+            V[0xF] = right ? source & 0x1u : source >> 7u;
+            CHIP8_NEXT_STEP();
+        }
+        CHIP8_STEP(Annn)
+            cpu.index = step->ins.nnn();
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(Fx07)
+            CHIP8_SYNC_CYCLES();
+            V[step->ins.x] = cpu.delayTimer();
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(Fx1E)
+            cpu.index += V[step->ins.x];
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP(Fx15) CHIP8_STEP(Fx18)
+        CHIP8_STEP_ANY()
+            CHIP8_SYNC_CYCLES();
+            step->func(cpu, *step);
+            CHIP8_NEXT_STEP();
+        CHIP8_STEP_END() {
+            // Chain into the next block if it is compiled, fits the budget and no block was dropped for memory this
+            // one wrote. When not chaining, only a block that loops back to itself is rerun.
+            executed += block->length;
+            if (cpu.writtenEnd == 0 || !syncWrites()) {
+                const Block *next = cpu.pc == block->start ? block : chain ? compiled(cpu.pc) : nullptr;
+                if (next != nullptr && next->length <= budget - executed &&
+                    next->steps.front().ins.op != vCPU::Op::OP_Fx07) {
+                    block = next;
+                    goto enter;
+                }
+            }
+            cpu.cycleCount = startCycle + executed;
+            return executed;
+        }
+#if defined(__GNUC__)
+    }
+#else
+        }
+    }
+#endif
+
+#undef CHIP8_SYNC_CYCLES
+#undef CHIP8_STEP
+#undef CHIP8_STEP_ANY
+#undef CHIP8_STEP_END
+#undef CHIP8_NEXT_STEP
+}
+
+const BlockEngine::Block *BlockEngine::compiled(const uint16_t address) const {
+    if (address & 1u || address >= sizeof(cpu.memory) - 1 || blockAt[address >> 1u] < 0) {
+        return nullptr;
+    }
+    return &blocks[blockAt[address >> 1u]];
+}
+
+BlockEngine::Block *BlockEngine::lookup(const uint16_t address) {
+    if (address & 1u || address >= sizeof(cpu.memory) - 1) {
+        return nullptr;
+    }
+
+    int32_t &slot = blockAt[address >> 1u];
+    if (slot < 0) {
+        Block block = compile(address);
+
+        for (unsigned int a = block.start; a < block.end; ++a) {
+            coverage[a / 64] |= uint64_t{1} << (a % 64);
+        }
+
+        if (freeBlocks.empty()) {
+            slot = static_cast<int32_t>(blocks.size());
+            blocks.push_back(std::move(block));
+        } else {
+            slot = freeBlocks.back();
+            freeBlocks.pop_back();
+            blocks[slot] = std::move(block);
+        }
+    }
+
+    return &blocks[slot];
+}
+
+BlockEngine::Block BlockEngine::compile(const uint16_t address) const {
+    Block block;
+    block.start = address;
+
+    unsigned int a = address;
+    size_t guarded = SIZE_MAX; // Step a skip may step over, which nothing can be folded into.
+    while (block.length < MAX_BLOCK_LENGTH && a + 1 < sizeof(cpu.memory)) {
+        const vCPU::Instruction ins = vCPU::decode(cpu.memory[a] << 8u | cpu.memory[a + 1]);
+        const auto offset = static_cast<uint8_t>(block.length);
+        a += 2;
+        ++block.length;
+
+        // Fold 7xnn into a preceding 6xnn/7xnn on the same register.
+        if (ins.op == vCPU::Op::OP_7xnn && !block.steps.empty() && block.steps.size() - 1 != guarded) {
+            Step &last = block.steps.back();
+            if ((last.ins.op == vCPU::Op::OP_6xnn || last.ins.op == vCPU::Op::OP_7xnn) &&
+                last.ins.x == ins.x && last.cycles < UINT8_MAX) {
+                last.ins.nn += ins.nn;
+                ++last.cycles;
+                continue;
+            }
+        }
+
+        block.steps.push_back(Step{stepFunc(ins.op), ins, 1, offset});
+
+        // A skip stays inside the block when the instruction after it fits too, the block going on past both
+        // unless that instruction ends it. Otherwise the skip ends the block and moves pc.
+        if (isSkip(ins.op) && block.length < MAX_BLOCK_LENGTH && a + 1 < sizeof(cpu.memory)) {
+            block.steps.back().overStep = true;
+            guarded = block.steps.size();
+            continue;
+        }
+
+        if (endsBlock(ins.op)) {
+            break;
+        }
+    }
+
+    block.end = a;
+    const vCPU::Instruction end{vCPU::Op::BlockEnd};
+    block.steps.push_back(Step{stepFunc(end.op), end, 0, 0});
+    return block;
+}
+
+bool BlockEngine::syncWrites() {
+    const bool dropped = cpu.writtenBegin < cpu.writtenEnd && invalidate(cpu.writtenBegin, cpu.writtenEnd);
+
+    cpu.writtenBegin = 0xFFFF;
+    cpu.writtenEnd = 0;
+    return dropped;
+}
+
+bool BlockEngine::invalidate(const unsigned int begin, const unsigned int end) {
+    bool covered = false;
+    for (unsigned int a = begin; a < end && !covered; ++a) {
+        covered = coverage[a / 64] & uint64_t{1} << (a % 64);
+    }
+    if (!covered) {
+        return false;
+    }
+
+    std::fill(std::begin(coverage), std::end(coverage), 0);
+
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        Block &block = blocks[i];
+        if (block.length == 0) {
+            continue; // Already free.
+        }
+
+        if (block.start < end && begin < block.end) {
+            blockAt[block.start >> 1u] = -1;
+            freeBlocks.push_back(static_cast<int32_t>(i));
+            block = Block{};
+        } else {
+            for (unsigned int a = block.start; a < block.end; ++a) {
+                coverage[a / 64] |= uint64_t{1} << (a % 64);
+            }
+        }
+    }
+
+    return true;
+}
+
+BlockEngine::StepFunc BlockEngine::stepFunc(const vCPU::Op op) {
+    switch (op) {
+        case vCPU::Op::OP_00E0: return [](vCPU &c, const Step &) { c.OP_00E0(); };
+        case vCPU::Op::OP_00EE: return [](vCPU &c, const Step &) { c.OP_00EE(); };
+        case vCPU::Op::OP_1nnn: return [](vCPU &c, const Step &s) { c.OP_1nnn(s.ins); };
+        case vCPU::Op::OP_2nnn: return [](vCPU &c, const Step &s) { c.OP_2nnn(s.ins); };
+        case vCPU::Op::OP_3xnn: return [](vCPU &c, const Step &s) { c.OP_3xnn(s.ins); };
+        case vCPU::Op::OP_4xnn: return [](vCPU &c, const Step &s) { c.OP_4xnn(s.ins); };
+        case vCPU::Op::OP_5xy0: return [](vCPU &c, const Step &s) { c.OP_5xy0(s.ins); };
+        case vCPU::Op::OP_6xnn: return [](vCPU &c, const Step &s) { c.OP_6xnn(s.ins); };
+        case vCPU::Op::OP_7xnn: return [](vCPU &c, const Step &s) { c.OP_7xnn(s.ins); };
+        case vCPU::Op::OP_8xy0: return [](vCPU &c, const Step &s) { c.OP_8xy0(s.ins); };
+        case vCPU::Op::OP_8xy1: return [](vCPU &c, const Step &s) { c.OP_8xy1(s.ins); };
+        case vCPU::Op::OP_8xy2: return [](vCPU &c, const Step &s) { c.OP_8xy2(s.ins); };
+        case vCPU::Op::OP_8xy3: return [](vCPU &c, const Step &s) { c.OP_8xy3(s.ins); };
+        case vCPU::Op::OP_8xy4: return [](vCPU &c, const Step &s) { c.OP_8xy4(s.ins); };
+        case vCPU::Op::OP_8xy5: return [](vCPU &c, const Step &s) { c.OP_8xy5(s.ins); };
+        case vCPU::Op::OP_8xy6: return [](vCPU &c, const Step &s) { c.OP_8xy6(s.ins); };
+        case vCPU::Op::OP_8xy7: return [](vCPU &c, const Step &s) { c.OP_8xy7(s.ins); };
+        case vCPU::Op::OP_8xyE: return [](vCPU &c, const Step &s) { c.OP_8xyE(s.ins); };
+        case vCPU::Op::OP_9xy0: return [](vCPU &c, const Step &s) { c.OP_9xy0(s.ins); };
+        case vCPU::Op::OP_Annn: return [](vCPU &c, const Step &s) { c.OP_Annn(s.ins); };
+        case vCPU::Op::OP_Bnnn: return [](vCPU &c, const Step &s) { c.OP_Bnnn(s.ins); };
+        case vCPU::Op::OP_Cxnn: return [](vCPU &c, const Step &s) { c.OP_Cxnn(s.ins); };
+        case vCPU::Op::OP_Dxyn: return [](vCPU &c, const Step &s) { c.OP_Dxyn(s.ins); };
+        case vCPU::Op::OP_Ex9E: return [](vCPU &c, const Step &s) { c.OP_Ex9E(s.ins); };
+        case vCPU::Op::OP_ExA1: return [](vCPU &c, const Step &s) { c.OP_ExA1(s.ins); };
+        case vCPU::Op::OP_Fx07: return [](vCPU &c, const Step &s) { c.OP_Fx07(s.ins); };
+        case vCPU::Op::OP_Fx0A: return [](vCPU &c, const Step &s) { c.OP_Fx0A(s.ins); };
+        case vCPU::Op::OP_Fx15: return [](vCPU &c, const Step &s) { c.OP_Fx15(s.ins); };
+        case vCPU::Op::OP_Fx18: return [](vCPU &c, const Step &s) { c.OP_Fx18(s.ins); };
+        case vCPU::Op::OP_Fx1E: return [](vCPU &c, const Step &s) { c.OP_Fx1E(s.ins); };
+        case vCPU::Op::OP_Fx29: return [](vCPU &c, const Step &s) { c.OP_Fx29(s.ins); };
+        case vCPU::Op::OP_Fx33: return [](vCPU &c, const Step &s) { c.OP_Fx33(s.ins); };
+        case vCPU::Op::OP_Fx55: return [](vCPU &c, const Step &s) { c.OP_Fx55(s.ins); };
+        case vCPU::Op::OP_Fx65: return [](vCPU &c, const Step &s) { c.OP_Fx65(s.ins); };
+        default: // OP_NULL, and SUPER-CHIP and XO-CHIP instructions a plain CHIP-8 vCPU never decodes.
+            break;
+    }
+    return [](vCPU &, const Step &) {};
+}
+
+bool BlockEngine::endsBlock(const vCPU::Op op) {
+    switch (op) {
+        case vCPU::Op::OP_00EE:
+        case vCPU::Op::OP_1nnn:
+        case vCPU::Op::OP_2nnn:
+        case vCPU::Op::OP_3xnn:
+        case vCPU::Op::OP_4xnn:
+        case vCPU::Op::OP_5xy0:
+        case vCPU::Op::OP_9xy0:
+        case vCPU::Op::OP_Bnnn:
+        case vCPU::Op::OP_Dxyn:
+        case vCPU::Op::OP_Ex9E:
+        case vCPU::Op::OP_ExA1:
+        case vCPU::Op::OP_Fx0A:
+        case vCPU::Op::OP_Fx33:
+        case vCPU::Op::OP_Fx55:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool BlockEngine::isSkip(const vCPU::Op op) {
+    return op == vCPU::Op::OP_3xnn || op == vCPU::Op::OP_4xnn || op == vCPU::Op::OP_5xy0 || op == vCPU::Op::OP_9xy0 ||
+           op == vCPU::Op::OP_Ex9E || op == vCPU::Op::OP_ExA1;
+}
+
+// --- Differential Testing ---
+
+bool BlockEngine::verify(const vCPU &cpu, const unsigned long long cycles, Mismatch &mismatch) {
+    vCPU expected = cpu;
+    vCPU actual = cpu;
+    BlockEngine engine(actual);
+
+    unsigned long long done = 0;
+    while (done < cycles) {
+        const uint16_t pc = actual.pc;
+        const unsigned long long executed = engine.dispatch(cycles - done, false);
+        expected.run(executed);
+        done += executed;
+
+        if (!compare(expected, actual, mismatch)) {
+            mismatch.cycle = done;
+            mismatch.pc = pc;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool BlockEngine::compare(const vCPU &expected, const vCPU &actual, Mismatch &mismatch) {
+    const auto check = [&mismatch](const bool same, std::string field, const int e, const int a) {
+        if (!same) {
+            mismatch.field = std::move(field);
+            mismatch.expected = e;
+            mismatch.actual = a;
+        }
+        return same;
+    };
+
+    for (unsigned int i = 0; i < 16; ++i) {
+        if (!check(expected.registers[i] == actual.registers[i], "V" + std::to_string(i),
+                   expected.registers[i], actual.registers[i])) return false;
+    }
+    if (!check(expected.index == actual.index, "I", expected.index, actual.index)) return false;
+    if (!check(expected.pc == actual.pc, "PC", expected.pc, actual.pc)) return false;
+    if (!check(expected.sp == actual.sp, "SP", expected.sp, actual.sp)) return false;
+    if (!check(expected.cycleCount == actual.cycleCount, "cycles", static_cast<int>(expected.cycleCount),
+               static_cast<int>(actual.cycleCount))) return false;
+    if (!check(expected.delayTimer() == actual.delayTimer(), "DT", expected.delayTimer(), actual.delayTimer())) return false;
+    if (!check(expected.soundTimer() == actual.soundTimer(), "ST", expected.soundTimer(), actual.soundTimer())) return false;
+
+    for (unsigned int i = 0; i < 16; ++i) {
+        if (!check(expected.stack[i] == actual.stack[i], "stack[" + std::to_string(i) + "]",
+                   expected.stack[i], actual.stack[i])) return false;
+    }
+
+    if (std::memcmp(expected.memory, actual.memory, sizeof(expected.memory)) != 0) {
+        for (unsigned int i = 0; i < sizeof(expected.memory); ++i) {
+            if (!check(expected.memory[i] == actual.memory[i], "memory[" + std::to_string(i) + "]",
+                       expected.memory[i], actual.memory[i])) return false;
+        }
+    }
+
+    for (unsigned int y = 0; y < 32; ++y) {
+        for (unsigned int x = 0; x < 64 && expected.video[y] != actual.video[y]; ++x) {
+            if (!check(expected.pixel(x, y) == actual.pixel(x, y),
+                       "pixel(" + std::to_string(x) + ", " + std::to_string(y) + ")",
+                       expected.pixel(x, y), actual.pixel(x, y))) return false;
+        }
+    }
+
+    return true;
+}
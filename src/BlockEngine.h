@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vCPU.h"
+
+// Optional execution engine over the state of a vCPU.
+// Runs of instructions ending at a jump, call, return, key wait, memory write or draw, skips included, are
+// compiled once and executed a whole block per dispatch as threaded code, the common instructions in place and
+// the rest through their vCPU handler. Blocks chain straight into the next compiled one until the budget runs out
+// or memory is written. A block is dropped when memory it was compiled from is written. Results match vCPU::run()
+// cycle for cycle.
+class BlockEngine {
+public:
+    explicit BlockEngine(vCPU &cpu);
+
+    void run(unsigned long long cycles); // Execute exactly this many cycles.
+    void flush(); // Drop every compiled block, e.g. after loading a new ROM.
+
+    [[nodiscard]] size_t blockCount() const { return blocks.size() - freeBlocks.size(); }
+
+    // First difference found by verify().
+    struct Mismatch {
+        unsigned long long cycle = 0; // Cycles executed when the difference was found.
+        uint16_t pc = 0; // Address of the block that produced it.
+        std::string field;
+        int expected = 0; // Interpreter value.
+        int actual = 0; // Block engine value.
+    };
+
+    // Run two copies of cpu for a number of cycles, one through vCPU::run() and one through the block engine,
+    // comparing their state after every block. Returns false and fills mismatch on the first difference.
+    static bool verify(const vCPU &cpu, unsigned long long cycles, Mismatch &mismatch);
+
+private:
+    struct Step;
+    typedef void (*StepFunc)(vCPU &cpu, const Step &step);
+
+    // One compiled instruction. A step of 6xnn/7xnn followed by 7xnn on the same register covers them all,
+    // carrying the combined immediate. Every block ends in a step with op BlockEnd.
+    struct Step {
+        StepFunc func; // Handler for the instructions dispatch() does not execute in place.
+        vCPU::Instruction ins;
+        uint8_t cycles;
+        uint8_t offset; // Cycles into the block, to bring cycleCount up to date before reading a timer.
+        bool overStep = false; // A skip whose next instruction is the next step, so skipping steps over it.
+    };
+
+    struct Block {
+        uint16_t start = 0; // Address of the first instruction.
+        uint16_t end = 0; // Address after the last instruction, pc when the block finishes without branching.
+        uint16_t length = 0; // Instructions in the block, i.e. cycles it costs.
+        std::vector<Step> steps;
+    };
+
+    static constexpr unsigned int MAX_BLOCK_LENGTH = 64;
+
+    // Run a block, one interpreted cycle or a skipped wait. Chaining goes on into the blocks that follow.
+    unsigned long long dispatch(unsigned long long budget, bool chain);
+    [[nodiscard]] const Block *compiled(uint16_t address) const; // The block at address, if compiled yet.
+    Block *lookup(uint16_t address); // The block at address, compiled now if need be.
+    [[nodiscard]] Block compile(uint16_t address) const;
+    bool syncWrites(); // Drop blocks over memory written since the last call, returning whether there were any.
+    bool invalidate(unsigned int begin, unsigned int end);
+
+    static StepFunc stepFunc(vCPU::Op op);
+    static bool endsBlock(vCPU::Op op);
+    static bool isSkip(vCPU::Op op);
+    static bool compare(const vCPU &expected, const vCPU &actual, Mismatch &mismatch);
+
+    vCPU &cpu;
+    std::vector<Block> blocks;
+    std::vector<int32_t> freeBlocks;
+    int32_t blockAt[4096 / 2]{}; // Block compiled at each even address, -1 when none.
+    uint64_t coverage[4096 / 64]{}; // Addresses compiled into any live block.
+};
@@ -0,0 +1,92 @@
+#include "Disassembler.h"
+
+#include <cstdio>
+
+std::string disassemble(const uint16_t opcode, const uint16_t next) {
+    const unsigned int x = (opcode & 0x0F00u) >> 8u;
+    const unsigned int y = (opcode & 0x00F0u) >> 4u;
+    const unsigned int n = opcode & 0x000Fu;
+    const unsigned int nn = opcode & 0x00FFu;
+    const unsigned int nnn = opcode & 0x0FFFu;
+
+    char text[32];
+    const auto format = [&text](const char *pattern, const auto... args) {
+        std::snprintf(text, sizeof(text), pattern, args...);
+        return std::string(text);
+    };
+
+    switch (opcode >> 12u) {
+        case 0x0:
+            if (opcode == 0x00E0) return "CLS";
+            if (opcode == 0x00EE) return "RET";
+            if (opcode == 0x00FB) return "SCR";
+            if (opcode == 0x00FC) return "SCL";
+            if (opcode == 0x00FD) return "EXIT";
+            if (opcode == 0x00FE) return "LOW";
+            if (opcode == 0x00FF) return "HIGH";
+            if ((opcode & 0xFFF0u) == 0x00C0) return format("SCD %u", n);
+            if ((opcode & 0xFFF0u) == 0x00D0) return format("SCU %u", n);
+            return format("SYS 0x%03X", nnn);
+        case 0x1: return format("JP 0x%03X", nnn);
+        case 0x2: return format("CALL 0x%03X", nnn);
+        case 0x3: return format("SE V%X, 0x%02X", x, nn);
+        case 0x4: return format("SNE V%X, 0x%02X", x, nn);
+        case 0x5:
+            if (n == 0) return format("SE V%X, V%X", x, y);
+            if (n == 2) return format("SAVE V%X - V%X", x, y);
+            if (n == 3) return format("LOAD V%X - V%X", x, y);
+            break;
+        case 0x6: return format("LD V%X, 0x%02X", x, nn);
+        case 0x7: return format("ADD V%X, 0x%02X", x, nn);
+        case 0x8:
+            switch (n) {
+                case 0x0: return format("LD V%X, V%X", x, y);
+                case 0x1: return format("OR V%X, V%X", x, y);
+                case 0x2: return format("AND V%X, V%X", x, y);
+                case 0x3: return format("XOR V%X, V%X", x, y);
+                case 0x4: return format("ADD V%X, V%X", x, y);
+                case 0x5: return format("SUB V%X, V%X", x, y);
+                case 0x6: return format("SHR V%X, V%X", x, y);
+                case 0x7: return format("SUBN V%X, V%X", x, y);
+                case 0xE: return format("SHL V%X, V%X", x, y);
+                default: break;
+            }
+            break;
+        case 0x9:
+            if (n == 0) return format("SNE V%X, V%X", x, y);
+            break;
+        case 0xA: return format("LD I, 0x%03X", nnn);
+        case 0xB: return format("JP V0, 0x%03X", nnn);
+        case 0xC: return format("RND V%X, 0x%02X", x, nn);
+        case 0xD: return format("DRW V%X, V%X, %u", x, y, n);
+        case 0xE:
+            if (nn == 0x9E) return format("SKP V%X", x);
+            if (nn == 0xA1) return format("SKNP V%X", x);
+            break;
+        case 0xF:
+            if (opcode == 0xF000) return format("LD I, 0x%04X", static_cast<unsigned int>(next));
+            if (opcode == 0xF002) return "AUDIO";
+            switch (nn) {
+                case 0x01: return format("PLANE %u", x);
+                case 0x07: return format("LD V%X, DT", x);
+                case 0x0A: return format("LD V%X, K", x);
+                case 0x15: return format("LD DT, V%X", x);
+                case 0x18: return format("LD ST, V%X", x);
+                case 0x1E: return format("ADD I, V%X", x);
+                case 0x29: return format("LD F, V%X", x);
+                case 0x30: return format("LD HF, V%X", x);
+                case 0x33: return format("LD B, V%X", x);
+                case 0x3A: return format("PITCH V%X", x);
+                case 0x55: return format("LD [I], V%X", x);
+                case 0x65: return format("LD V%X, [I]", x);
+                case 0x75: return format("LD R, V%X", x);
+                case 0x85: return format("LD V%X, R", x);
+                default: break;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return format("DW 0x%04X", static_cast<unsigned int>(opcode));
+}
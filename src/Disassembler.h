@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Mnemonic for one instruction, in the notation of Cowgod's technical reference extended with the SUPER-CHIP and
+// XO-CHIP instructions, e.g. "LD V1, 0x20" or "DRW V0, V1, 5". next is the word after it, the address F000 loads.
+// Words that are no instruction come out as "DW 0x1234".
+std::string disassemble(uint16_t opcode, uint16_t next = 0);
+
+// Bytes the instruction takes, 4 for F000 nnnn and 2 for everything else.
+inline unsigned int instructionLength(const uint16_t opcode) { return opcode == 0xF000 ? 4 : 2; }
@@ -0,0 +1,62 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+FrameScheduler::FrameScheduler() {
+    lateness.reserve(1024);
+
+#ifdef _WIN32
+    // Default Windows sleep granularity is ~15.6ms, far coarser than a frame.
+    timeBeginPeriod(1);
+#endif
+}
+
+FrameScheduler::~FrameScheduler() {
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+void FrameScheduler::sleepUntil(const clock::time_point deadline) {
+    const auto sleepTarget = deadline - spinMargin;
+
+    if (clock::now() < sleepTarget) {
+        std::this_thread::sleep_until(sleepTarget);
+
+        // Size the spin from how late the OS wakes us: a bit over the recent average, within sane bounds.
+        const double late = std::chrono::duration<double>(clock::now() - sleepTarget).count();
+        oversleep = oversleep * 0.9 + std::max(late, 0.0) * 0.1;
+        const auto margin = std::chrono::duration<double>(std::clamp(oversleep * 2.0, 50e-6, 4e-3));
+        spinMargin = std::chrono::duration_cast<clock::duration>(margin);
+    }
+
+    while (clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+
+    if (lateness.size() < lateness.capacity()) {
+        lateness.push_back(std::chrono::duration<double, std::micro>(clock::now() - deadline).count());
+    }
+}
+
+FrameScheduler::Jitter FrameScheduler::takeJitter() {
+    Jitter jitter;
+    if (lateness.empty()) {
+        return jitter;
+    }
+
+    std::sort(lateness.begin(), lateness.end());
+    jitter.p50 = lateness[lateness.size() / 2];
+    jitter.p99 = lateness[std::min(lateness.size() - 1, lateness.size() * 99 / 100)];
+    jitter.max = lateness.back();
+
+    lateness.clear();
+    return jitter;
+}
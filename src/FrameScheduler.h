@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+// Waits for fixed-timestep deadlines without burning a core.
+// Most of the wait is an OS sleep, the last stretch is a short spin sized from how late recent sleeps woke up,
+// giving sub-millisecond accuracy at near-zero idle CPU.
+class FrameScheduler {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    FrameScheduler();
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler &) = delete;
+    FrameScheduler &operator=(const FrameScheduler &) = delete;
+
+    void sleepUntil(clock::time_point deadline);
+
+    // Wake-up lateness percentiles in microseconds, over the waits since the last call.
+    struct Jitter {
+        double p50 = 0;
+        double p99 = 0;
+        double max = 0;
+    };
+
+    Jitter takeJitter();
+
+private:
+    clock::duration spinMargin = std::chrono::milliseconds(1); // Left to spin after the OS sleep.
+    double oversleep = 0; // Moving average of how late the OS sleep wakes, in seconds.
+    std::vector<double> lateness; // Microseconds past each deadline.
+};
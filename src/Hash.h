@@ -0,0 +1,38 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Fast non-cryptographic 64-bit hash, 8 bytes per round. Used for state/frame hashes and ROM identity.
+inline uint64_t hash64(const void *data, size_t size, const uint64_t seed = 0) {
+    constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = seed ^ (static_cast<uint64_t>(size) * P1);
+
+    while (size >= 8) {
+        uint64_t k;
+        std::memcpy(&k, bytes, sizeof(k));
+        h ^= std::rotl(k * P2, 31) * P1;
+        h = std::rotl(h, 27) * P1 + P2;
+        bytes += 8;
+        size -= 8;
+    }
+
+    if (size > 0) {
+        uint64_t k = 0;
+        std::memcpy(&k, bytes, size);
+        h ^= std::rotl(k * P2, 31) * P1;
+        h = std::rotl(h, 27) * P1 + P2;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P1;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,509 @@
+#include "LockstepBatch.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_LOCKSTEP_SSE2
+#include <emmintrin.h>
+#endif
+
+LockstepBatch::LockstepBatch(const vCPU &prototype) :
+    lanes(LANES, prototype)
+{
+    // Every lane starts as a copy of the prototype, so no byte differs yet.
+    for (unsigned int l = 0; l < LANES; ++l) {
+        lanes[l].writtenBegin = 0xFFFF;
+        lanes[l].writtenEnd = 0;
+        scatter(l);
+        runStart[l] = lanes[l].cycleCount;
+    }
+}
+
+void LockstepBatch::seed(const unsigned int l, const uint64_t value) {
+    lanes[l].seed(value);
+}
+
+void LockstepBatch::setKeys(const uint16_t *keys) {
+    for (unsigned int l = 0; l < LANES; ++l) {
+        for (unsigned int k = 0; k < 16; ++k) {
+            lanes[l].keypad[k] = keys[l] >> k & 1u;
+        }
+    }
+}
+
+const vCPU &LockstepBatch::lane(const unsigned int l) {
+    gather(l);
+    return lanes[l];
+}
+
+void LockstepBatch::gather(const unsigned int l) {
+    vCPU &cpu = lanes[l];
+    for (unsigned int r = 0; r < 16; ++r) {
+        cpu.registers[r] = V[r][l];
+    }
+    cpu.index = index[l];
+    cpu.pc = pc[l];
+    cpu.cycleCount = runStart[l] + runCycles - remaining[l];
+}
+
+void LockstepBatch::scatter(const unsigned int l) {
+    const vCPU &cpu = lanes[l];
+    for (unsigned int r = 0; r < 16; ++r) {
+        V[r][l] = cpu.registers[r];
+    }
+    index[l] = cpu.index;
+    pc[l] = cpu.pc;
+}
+
+void LockstepBatch::trackWrites(const unsigned int l) {
+    vCPU &cpu = lanes[l];
+    if (cpu.writtenBegin >= cpu.writtenEnd) {
+        return;
+    }
+
+    for (unsigned int a = cpu.writtenBegin; a < cpu.writtenEnd; ++a) {
+        bool same = true;
+        for (unsigned int other = 0; other < LANES && same; ++other) {
+            same = lanes[other].memory[a] == cpu.memory[a];
+        }
+
+        if (same) {
+            differing[a / 64] &= ~(uint64_t{1} << (a % 64));
+        } else {
+            differing[a / 64] |= uint64_t{1} << (a % 64);
+        }
+    }
+
+    cpu.writtenBegin = 0xFFFF;
+    cpu.writtenEnd = 0;
+}
+
+void LockstepBatch::runAlone(const unsigned int l, const unsigned int ahead) {
+    gather(l);
+    vCPU &cpu = lanes[l];
+    do {
+        cpu.run(1);
+        --remaining[l];
+        ++scalarSteps;
+    } while (remaining[l] > 0 && cpu.pc < ahead);
+    scatter(l);
+    trackWrites(l);
+}
+
+vCPU::Instruction LockstepBatch::instruction(const uint16_t opcode) {
+    return vCPU::Instruction{vCPU::HANDLERS[opcode], static_cast<uint8_t>(opcode >> 8u & 0xFu),
+                             static_cast<uint8_t>(opcode >> 4u & 0xFu), static_cast<uint8_t>(opcode)};
+}
+
+void LockstepBatch::run(const unsigned int cycles) {
+    // Lane cycle counts are worked out from remaining when a lane needs one.
+    for (unsigned int l = 0; l < LANES; ++l) {
+        runStart[l] += runCycles;
+        remaining[l] = cycles;
+    }
+    runCycles = cycles;
+
+    alignas(16) uint8_t mask[LANES];
+
+    while (true) {
+        // The lowest pc with cycles left leads, lanes that branched ahead wait for it to catch up.
+        unsigned int first = LANES;
+        for (unsigned int l = 0; l < LANES; ++l) {
+            if (remaining[l] > 0 && (first == LANES || pc[l] < pc[first])) {
+                first = l;
+            }
+        }
+        if (first == LANES) {
+            break;
+        }
+
+        const unsigned int address = pc[first] & 0x0FFFu;
+        const unsigned int next = (address + 1) & 0x0FFFu;
+        const uint8_t hi = lanes[first].memory[address];
+        const uint8_t lo = lanes[first].memory[next];
+        const bool sameCode = ((differing[address / 64] >> (address % 64) | differing[next / 64] >> (next % 64)) & 1u) == 0;
+
+        // Lanes at the same pc about to run the same opcode, and the lowest pc above it.
+        unsigned int count = 0;
+        unsigned int ahead = 0x10000;
+        for (unsigned int l = 0; l < LANES; ++l) {
+            if (remaining[l] == 0) {
+                mask[l] = 0x00;
+                continue;
+            }
+            const bool with = pc[l] == pc[first] &&
+                              (sameCode || (lanes[l].memory[address] == hi && lanes[l].memory[next] == lo));
+            mask[l] = with ? 0xFF : 0x00;
+            count += with;
+            if (pc[l] != pc[first]) {
+                ahead = std::min<unsigned int>(ahead, pc[l]);
+            }
+        }
+
+        // Alone, the lane runs on through vCPU, gathered once, until it reaches a lane that waits for it.
+        if (count == 1) {
+            runAlone(first, ahead);
+            continue;
+        }
+
+        const vCPU::Instruction ins = instruction(hi << 8u | lo);
+        if (vectorizable(ins.op)) {
+            const int skip = executeVector(ins, mask);
+            for (unsigned int l = 0; l < LANES; ++l) {
+                if (mask[l]) {
+                    pc[l] = ins.op == vCPU::Op::OP_1nnn ? ins.nnn() : pc[l] + (skip >> l & 1 ? 4 : 2);
+                }
+            }
+        } else if (perLane(ins.op)) {
+            executeLanes(ins, mask);
+        } else {
+            // Anything else runs one instruction per lane through vCPU.
+            for (unsigned int l = 0; l < LANES; ++l) {
+                if (mask[l]) {
+                    runAlone(l, 0);
+                }
+            }
+            continue;
+        }
+
+        for (unsigned int l = 0; l < LANES; ++l) {
+            remaining[l] -= mask[l] & 1u;
+        }
+        ++vectorSteps;
+
+        if (count == LANES) {
+            runConverged(mask);
+        }
+    }
+}
+
+void LockstepBatch::runConverged(const uint8_t *mask) {
+    uint32_t budget = remaining[0];
+    for (const auto r : remaining) {
+        budget = std::min(budget, r);
+    }
+
+    uint16_t at = pc[0];
+    if (std::any_of(pc, pc + LANES, [at](const uint16_t p) { return p != at; })) {
+        return;
+    }
+
+    // Steps run since pc and remaining were last written back.
+    uint32_t steps = 0;
+    const auto writeBack = [&] {
+        for (unsigned int l = 0; l < LANES; ++l) {
+            pc[l] = at;
+            remaining[l] -= steps;
+        }
+        budget -= steps;
+        steps = 0;
+    };
+
+    while (steps < budget) {
+        const unsigned int address = at & 0x0FFFu;
+        const unsigned int next = (address + 1) & 0x0FFFu;
+        if (((differing[address / 64] >> (address % 64) | differing[next / 64] >> (next % 64)) & 1u) != 0) {
+            break;
+        }
+
+        const vCPU::Instruction ins = instruction(lanes[0].memory[address] << 8u | lanes[0].memory[next]);
+        if (vectorizable(ins.op)) {
+            const int skip = executeVector(ins, mask);
+            ++steps;
+            ++vectorSteps;
+
+            if (ins.op == vCPU::Op::OP_1nnn) {
+                at = ins.nnn();
+            } else if (skip == 0) {
+                at += 2;
+            } else if (skip == 0xFFFF) {
+                at += 4;
+            } else {
+                // The lanes took different sides of a skip.
+                for (unsigned int l = 0; l < LANES; ++l) {
+                    pc[l] = at + (skip >> l & 1 ? 4 : 2);
+                    remaining[l] -= steps;
+                }
+                return;
+            }
+        } else if (perLane(ins.op)) {
+            writeBack();
+            const bool split = executeLanes(ins, mask);
+            for (unsigned int l = 0; l < LANES; ++l) {
+                --remaining[l];
+            }
+            --budget;
+            ++vectorSteps;
+
+            if (split) {
+                return;
+            }
+            at = pc[0];
+        } else {
+            break;
+        }
+    }
+
+    writeBack();
+}
+
+bool LockstepBatch::perLane(const vCPU::Op op) {
+    switch (op) {
+        case vCPU::Op::OP_00E0:
+        case vCPU::Op::OP_00EE:
+        case vCPU::Op::OP_2nnn:
+        case vCPU::Op::OP_Cxnn:
+        case vCPU::Op::OP_Dxyn:
+        case vCPU::Op::OP_Ex9E:
+        case vCPU::Op::OP_ExA1:
+        case vCPU::Op::OP_Fx07:
+        case vCPU::Op::OP_Fx15:
+        case vCPU::Op::OP_Fx18:
+        case vCPU::Op::OP_Fx29:
+        case vCPU::Op::OP_Fx33:
+        case vCPU::Op::OP_Fx55:
+        case vCPU::Op::OP_Fx65:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool LockstepBatch::executeLanes(const vCPU::Instruction ins, const uint8_t *mask) {
+    // Only the registers the handlers touch are copied: VX, VY, VF, and V0 to VX for Fx55 and Fx65.
+    const unsigned int last = ins.op == vCPU::Op::OP_Fx55 || ins.op == vCPU::Op::OP_Fx65 ? ins.x : 0;
+    uint8_t *VX = V[ins.x];
+    unsigned int first = LANES;
+    bool split = false;
+
+    // Stores from every lane, compared across lanes once afterwards.
+    unsigned int writtenBegin = 0xFFFF;
+    unsigned int writtenEnd = 0;
+
+    for (unsigned int l = 0; l < LANES; ++l) {
+        if (!mask[l]) {
+            continue;
+        }
+
+        vCPU &cpu = lanes[l];
+        switch (ins.op) {
+            case vCPU::Op::OP_00EE:
+                --cpu.sp;
+                pc[l] = cpu.stack[cpu.sp & 0xFu];
+                break;
+            case vCPU::Op::OP_2nnn:
+                cpu.stack[cpu.sp & 0xFu] = pc[l] + 2;
+                ++cpu.sp;
+                pc[l] = ins.nnn();
+                break;
+            case vCPU::Op::OP_Cxnn:
+                VX[l] = cpu.randomByte() & ins.nn;
+                pc[l] += 2;
+                break;
+            case vCPU::Op::OP_Ex9E:
+                pc[l] += cpu.keypad[VX[l] & 0xFu] != 0 ? 4 : 2;
+                break;
+            case vCPU::Op::OP_ExA1:
+                pc[l] += cpu.keypad[VX[l] & 0xFu] == 0 ? 4 : 2;
+                break;
+            case vCPU::Op::OP_Fx29:
+                index[l] = 0x50 + (VX[l] & 0xFu) * 5;
+                pc[l] += 2;
+                break;
+            default:
+                for (unsigned int r = 0; r <= last; ++r) {
+                    cpu.registers[r] = V[r][l];
+                }
+                cpu.registers[ins.x] = VX[l];
+                cpu.registers[ins.y] = V[ins.y][l];
+                cpu.registers[0xF] = V[0xF][l];
+                cpu.index = index[l];
+                cpu.cycleCount = runStart[l] + runCycles - remaining[l];
+
+                switch (ins.op) {
+                    case vCPU::Op::OP_00E0: cpu.OP_00E0(); break;
+                    case vCPU::Op::OP_Dxyn: cpu.OP_Dxyn(ins); break;
+                    case vCPU::Op::OP_Fx07: cpu.OP_Fx07(ins); break;
+                    case vCPU::Op::OP_Fx15: cpu.OP_Fx15(ins); break;
+                    case vCPU::Op::OP_Fx18: cpu.OP_Fx18(ins); break;
+                    case vCPU::Op::OP_Fx33: cpu.OP_Fx33(ins); break;
+                    case vCPU::Op::OP_Fx55: cpu.OP_Fx55(ins); break;
+                    case vCPU::Op::OP_Fx65: cpu.OP_Fx65(ins); break;
+                    default: break;
+                }
+
+                for (unsigned int r = 0; r <= last; ++r) {
+                    V[r][l] = cpu.registers[r];
+                }
+                VX[l] = cpu.registers[ins.x];
+                V[0xF][l] = cpu.registers[0xF];
+                index[l] = cpu.index;
+                pc[l] += 2;
+
+                writtenBegin = std::min<unsigned int>(writtenBegin, cpu.writtenBegin);
+                writtenEnd = std::max<unsigned int>(writtenEnd, cpu.writtenEnd);
+                cpu.writtenBegin = 0xFFFF;
+                cpu.writtenEnd = 0;
+                break;
+        }
+
+        if (first == LANES) {
+            first = l;
+        }
+        split |= pc[l] != pc[first];
+    }
+
+    if (writtenBegin < writtenEnd) {
+        lanes[first].writtenBegin = writtenBegin;
+        lanes[first].writtenEnd = writtenEnd;
+        trackWrites(first);
+    }
+
+    return split;
+}
+
+#ifdef CHIP8_LOCKSTEP_SSE2
+
+namespace {
+    __m128i load(const uint8_t *p) { return _mm_load_si128(reinterpret_cast<const __m128i *>(p)); }
+    void store(uint8_t *p, const __m128i v) { _mm_store_si128(reinterpret_cast<__m128i *>(p), v); }
+
+    // Write v into the lanes selected by mask, leaving the others as they are.
+    void storeMasked(uint8_t *p, const __m128i mask, const __m128i v) {
+        store(p, _mm_or_si128(_mm_and_si128(mask, v), _mm_andnot_si128(mask, load(p))));
+    }
+
+    __m128i greaterThan(const __m128i a, const __m128i b) { // Unsigned a > b.
+        return _mm_andnot_si128(_mm_cmpeq_epi8(_mm_max_epu8(b, a), b), _mm_set1_epi8(-1));
+    }
+}
+
+bool LockstepBatch::vectorizable(const vCPU::Op op) {
+    switch (op) {
+        case vCPU::Op::OP_NULL:
+        case vCPU::Op::OP_1nnn:
+        case vCPU::Op::OP_3xnn:
+        case vCPU::Op::OP_4xnn:
+        case vCPU::Op::OP_5xy0:
+        case vCPU::Op::OP_6xnn:
+        case vCPU::Op::OP_7xnn:
+        case vCPU::Op::OP_8xy0:
+        case vCPU::Op::OP_8xy1:
+        case vCPU::Op::OP_8xy2:
+        case vCPU::Op::OP_8xy3:
+        case vCPU::Op::OP_8xy4:
+        case vCPU::Op::OP_8xy5:
+        case vCPU::Op::OP_8xy6:
+        case vCPU::Op::OP_8xy7:
+        case vCPU::Op::OP_8xyE:
+        case vCPU::Op::OP_9xy0:
+        case vCPU::Op::OP_Annn:
+        case vCPU::Op::OP_Fx1E:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int LockstepBatch::executeVector(const vCPU::Instruction ins, const uint8_t *laneMask) {
+    const __m128i mask = load(laneMask);
+    const __m128i one = _mm_set1_epi8(1);
+    uint8_t *VX = V[ins.x];
+    uint8_t *VY = V[ins.y];
+    uint8_t *VF = V[0xF];
+
+    // Lanes that skip the next instruction.
+    int skip = 0;
+
+    switch (ins.op) {
+        case vCPU::Op::OP_3xnn:
+            skip = _mm_movemask_epi8(_mm_cmpeq_epi8(load(VX), _mm_set1_epi8(static_cast<char>(ins.nn))));
+            break;
+        case vCPU::Op::OP_4xnn:
+            skip = ~_mm_movemask_epi8(_mm_cmpeq_epi8(load(VX), _mm_set1_epi8(static_cast<char>(ins.nn))));
+            break;
+        case vCPU::Op::OP_5xy0:
+            skip = _mm_movemask_epi8(_mm_cmpeq_epi8(load(VX), load(VY)));
+            break;
+        case vCPU::Op::OP_9xy0:
+            skip = ~_mm_movemask_epi8(_mm_cmpeq_epi8(load(VX), load(VY)));
+            break;
+        case vCPU::Op::OP_6xnn:
+            storeMasked(VX, mask, _mm_set1_epi8(static_cast<char>(ins.nn)));
+            break;
+        case vCPU::Op::OP_7xnn:
+            storeMasked(VX, mask, _mm_add_epi8(load(VX), _mm_set1_epi8(static_cast<char>(ins.nn))));
+            break;
+        case vCPU::Op::OP_8xy0:
+            storeMasked(VX, mask, load(VY));
+            break;
+        case vCPU::Op::OP_8xy1:
+            storeMasked(VX, mask, _mm_or_si128(load(VX), load(VY)));
+            break;
+        case vCPU::Op::OP_8xy2:
+            storeMasked(VX, mask, _mm_and_si128(load(VX), load(VY)));
+            break;
+        case vCPU::Op::OP_8xy3:
+            storeMasked(VX, mask, _mm_xor_si128(load(VX), load(VY)));
+            break;
+        case vCPU::Op::OP_8xy4: {
+            // Same order as vCPU: the flag comes from the old registers and VF is written after VX.
+            const __m128i x = load(VX);
+            const __m128i sum = _mm_add_epi8(x, load(VY));
+            const __m128i carry = _mm_and_si128(greaterThan(x, sum), one);
+            storeMasked(VX, mask, sum);
+            storeMasked(VF, mask, carry);
+            break;
+        }
+        case vCPU::Op::OP_8xy5: {
+            const __m128i noBorrow = _mm_andnot_si128(greaterThan(load(VY), load(VX)), one);
+            storeMasked(VX, mask, _mm_sub_epi8(load(VX), load(VY)));
+            storeMasked(VF, mask, noBorrow);
+            break;
+        }
+        case vCPU::Op::OP_8xy6: {
+            const __m128i shiftedOut = _mm_and_si128(load(VX), one);
+            storeMasked(VX, mask, _mm_and_si128(_mm_srli_epi16(load(VX), 1), _mm_set1_epi8(0x7F)));
+            storeMasked(VF, mask, shiftedOut);
+            break;
+        }
+        case vCPU::Op::OP_8xy7: {
+            const __m128i noBorrow = _mm_andnot_si128(greaterThan(load(VX), load(VY)), one);
+            storeMasked(VX, mask, _mm_sub_epi8(load(VY), load(VX)));
+            storeMasked(VF, mask, noBorrow);
+            break;
+        }
+        case vCPU::Op::OP_8xyE: {
+            const __m128i shiftedOut = _mm_and_si128(_mm_srli_epi16(load(VX), 7), one);
+            storeMasked(VX, mask, _mm_add_epi8(load(VX), load(VX)));
+            storeMasked(VF, mask, shiftedOut);
+            break;
+        }
+        case vCPU::Op::OP_Annn:
+            for (unsigned int l = 0; l < LANES; ++l) {
+                if (laneMask[l]) index[l] = ins.nnn();
+            }
+            break;
+        case vCPU::Op::OP_Fx1E:
+            for (unsigned int l = 0; l < LANES; ++l) {
+                if (laneMask[l]) index[l] += VX[l];
+            }
+            break;
+        default:
+            break;
+    }
+
+    return skip & _mm_movemask_epi8(mask);
+}
+
+#else
+
+bool LockstepBatch::vectorizable(const vCPU::Op) {
+    return false; // Without SSE2 the register ops run one lane at a time through vCPU.
+}
+
+int LockstepBatch::executeVector(const vCPU::Instruction, const uint8_t *) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vCPU.h"
+
+// Runs LANES instances of the same ROM in lockstep.
+// Registers, index and pc live in lanes (one byte or word per instance), so an instruction that every lane is
+// about to execute, such as 6xnn, 7xnn, the 8xyN ALU ops or a skip, runs as a handful of SSE2 instructions for
+// all of them. Calls, returns, random numbers, key checks, timers, BCD, loads, stores and draws run for the
+// whole group in one pass over its lanes. A lane left on its own runs through vCPU until it catches up with the
+// others. Each lane's results match running a vCPU on its own.
+class LockstepBatch {
+public:
+    static constexpr unsigned int LANES = 16;
+
+    explicit LockstepBatch(const vCPU &prototype);
+
+    void seed(unsigned int l, uint64_t value); // Restart lane l's random generator, see vCPU::seed().
+    void setKeys(const uint16_t *keys); // One mask per lane, bit i set while key i is down.
+    void run(unsigned int cycles); // Run every lane for exactly this many cycles.
+
+    const vCPU &lane(unsigned int l); // Full state of a lane.
+
+    uint64_t vectorSteps = 0; // Instructions executed once for a group of lanes.
+    uint64_t scalarSteps = 0; // Instructions executed for a single lane.
+
+private:
+    void gather(unsigned int l); // Copy lane registers into lanes[l].
+    void scatter(unsigned int l); // Copy lanes[l] registers back into the lane arrays.
+
+    void trackWrites(unsigned int l); // Update the differing bitmap after lane l wrote memory.
+
+    // Run lane l through vCPU until its pc reaches ahead, where another lane waits, or its cycles run out.
+    void runAlone(unsigned int l, unsigned int ahead);
+
+    // Run while every lane shares one pc and the code there, keeping that pc and the cycles run in locals.
+    void runConverged(const uint8_t *mask);
+
+    static vCPU::Instruction instruction(uint16_t opcode); // Decoded through vCPU::HANDLERS, as vCPU fetches it.
+
+    // Returns a bit for each lane that skips, moving pc is left to the caller.
+    static bool vectorizable(vCPU::Op op);
+    int executeVector(vCPU::Instruction ins, const uint8_t *mask);
+
+    // Moves pc itself and returns true if the lanes no longer share one.
+    static bool perLane(vCPU::Op op);
+    bool executeLanes(vCPU::Instruction ins, const uint8_t *mask);
+
+    std::vector<vCPU> lanes; // Memory, stack, display, keypad and RNG of each lane.
+
+    // Timers stay in lanes[l], set and read against the lane's cycle count like any vCPU's.
+    alignas(16) uint8_t V[16][LANES]{}; // V[register][lane].
+    uint16_t index[LANES]{};
+    uint16_t pc[LANES]{};
+    uint32_t remaining[LANES]{};
+    uint64_t runStart[LANES]{}; // vCPU::cycleCount of each lane when run() began, remaining counts from there.
+    uint32_t runCycles = 0;
+
+    // Addresses whose byte is not the same in every lane. Only there do opcodes need comparing lane by lane.
+    uint64_t differing[4096 / 64]{};
+};
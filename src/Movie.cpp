@@ -0,0 +1,194 @@
+#include "Movie.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "BatchEngine.h"
+#include "Hash.h"
+#include "vCPU.h"
+
+namespace {
+    // File layout: header, then each key change as a varint of cycles since the previous change and the 16-bit
+    // mask, then one 64-bit hash per frame.
+    struct Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t cyclesPerFrame;
+        uint32_t keyChanges;
+        uint64_t frames;
+        uint64_t seed;
+        uint64_t romHash;
+    };
+
+    void writeVarint(std::vector<uint8_t> &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool readVarint(std::istream &in, uint64_t &value) {
+        value = 0;
+        for (unsigned int shift = 0; shift < 64; shift += 7) {
+            const int byte = in.get();
+            if (byte == EOF) {
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+uint64_t Movie::frameHash(const vCPU &cpu) {
+    return BatchEngine::stateHash(cpu);
+}
+
+uint64_t Movie::memoryHash(const vCPU &cpu) {
+    return hash64(cpu.memory, sizeof(cpu.memory));
+}
+
+uint16_t Movie::keyMask(const vCPU &cpu) {
+    uint16_t keys = 0;
+    for (unsigned int k = 0; k < 16; ++k) {
+        keys |= (cpu.keypad[k] ? 1u : 0u) << k;
+    }
+    return keys;
+}
+
+void Movie::begin(const vCPU &cpu, const uint64_t seed) {
+    this->seed = seed;
+    cyclesPerFrame = cpu.cyclesPerFrame;
+    romHash = memoryHash(cpu);
+    keyChanges.clear();
+    frameHashes.clear();
+    lastKeys = 0;
+    recordKeys(cpu);
+}
+
+void Movie::recordKeys(const vCPU &cpu) {
+    const uint16_t keys = keyMask(cpu);
+    if (keys == lastKeys) {
+        return;
+    }
+
+    // Several changes between two instructions collapse into the last one.
+    if (!keyChanges.empty() && keyChanges.back().cycle == cpu.cycleCount) {
+        keyChanges.back().keys = keys;
+    } else {
+        keyChanges.push_back(KeyChange{cpu.cycleCount, keys});
+    }
+    lastKeys = keys;
+}
+
+unsigned long long Movie::cyclesToFrameEnd(const vCPU &cpu) const {
+    return cyclesPerFrame - cpu.cycleCount % cyclesPerFrame;
+}
+
+void Movie::recordFrame(const vCPU &cpu) {
+    if (cpu.cycleCount > 0 && cpu.cycleCount % cyclesPerFrame == 0) {
+        frameHashes.push_back(frameHash(cpu));
+    }
+}
+
+bool Movie::save(const char *path) const {
+    std::vector<uint8_t> changes;
+    uint64_t previous = 0;
+    for (const KeyChange &change : keyChanges) {
+        writeVarint(changes, change.cycle - previous);
+        changes.push_back(static_cast<uint8_t>(change.keys));
+        changes.push_back(static_cast<uint8_t>(change.keys >> 8u));
+        previous = change.cycle;
+    }
+
+    const Header header{MAGIC, VERSION, 0, cyclesPerFrame, static_cast<uint32_t>(keyChanges.size()),
+                        frameHashes.size(), seed, romHash};
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(changes.data()), static_cast<std::streamsize>(changes.size()));
+    file.write(reinterpret_cast<const char *>(frameHashes.data()),
+               static_cast<std::streamsize>(frameHashes.size() * sizeof(uint64_t)));
+    return static_cast<bool>(file);
+}
+
+bool Movie::load(const char *path) {
+    std::ifstream file(path, std::ios::binary);
+    Header header{};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) || header.magic != MAGIC ||
+        header.version != VERSION || header.cyclesPerFrame == 0) {
+        return false;
+    }
+
+    seed = header.seed;
+    romHash = header.romHash;
+    cyclesPerFrame = header.cyclesPerFrame;
+
+    keyChanges.clear();
+    uint64_t cycle = 0;
+    for (uint32_t i = 0; i < header.keyChanges; ++i) {
+        uint64_t delta;
+        uint8_t keys[2];
+        if (!readVarint(file, delta) || !file.read(reinterpret_cast<char *>(keys), sizeof(keys))) {
+            return false;
+        }
+        cycle += delta;
+        keyChanges.push_back(KeyChange{cycle, static_cast<uint16_t>(keys[0] | keys[1] << 8u)});
+    }
+
+    // The hashes are the rest of the file, so a frame count it cannot hold is a bad header, not an allocation.
+    const std::streamoff hashesAt = file.tellg();
+    file.seekg(0, std::ios::end);
+    const std::streamoff remaining = file.tellg() - hashesAt;
+    if (hashesAt < 0 || remaining < 0 || header.frames > static_cast<uint64_t>(remaining) / sizeof(uint64_t)) {
+        return false;
+    }
+    file.seekg(hashesAt);
+
+    frameHashes.resize(header.frames);
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(frameHashes.data()),
+                                       static_cast<std::streamsize>(frameHashes.size() * sizeof(uint64_t))));
+}
+
+Movie::Result Movie::replay(vCPU &cpu, const std::function<void(unsigned long long)> &run) const {
+    Result result;
+    result.romMatches = memoryHash(cpu) == romHash;
+
+    cpu.seed(seed);
+    cpu.cyclesPerFrame = cyclesPerFrame;
+    const uint64_t start = cpu.cycleCount;
+    size_t nextChange = 0;
+
+    for (uint64_t frame = 0; frame < frameHashes.size(); ++frame) {
+        const uint64_t frameEnd = start + (frame + 1) * cyclesPerFrame;
+
+        // Run up to each key change inside the frame, apply it, then on to the end of the frame.
+        while (cpu.cycleCount < frameEnd) {
+            while (nextChange < keyChanges.size() && start + keyChanges[nextChange].cycle <= cpu.cycleCount) {
+                for (unsigned int k = 0; k < 16; ++k) {
+                    cpu.keypad[k] = keyChanges[nextChange].keys >> k & 1u;
+                }
+                ++nextChange;
+            }
+
+            uint64_t until = frameEnd;
+            if (nextChange < keyChanges.size()) {
+                until = std::min(until, start + keyChanges[nextChange].cycle);
+            }
+            run(until - cpu.cycleCount);
+        }
+
+        ++result.frames;
+        if (frameHash(cpu) != frameHashes[frame]) {
+            result.mismatchFrame = frame;
+            break;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "vCPU.h"
+
+// Input recording of a run, enough to reproduce it bit for bit: the random seed, the keypad state every time it
+// changed keyed by cycle, and a hash of the machine state at the end of every frame to check a replay against.
+// Recording has to start from a freshly loaded ROM on a vCPU seeded with seed.
+class Movie {
+public:
+    static constexpr uint32_t MAGIC = 0x564D3843; // "C8MV" in little-endian.
+    static constexpr uint16_t VERSION = 2;
+
+    struct KeyChange {
+        uint64_t cycle; // vCPU::cycleCount when the keys took effect.
+        uint16_t keys; // Bit i set while key i is down.
+    };
+
+    uint64_t seed = 0;
+    uint64_t romHash = 0; // Hash of memory at cycle 0, i.e. the font and the ROM.
+    uint32_t cyclesPerFrame = 10; // vCPU::cyclesPerFrame of the recording, frames end at multiples of it.
+    std::vector<KeyChange> keyChanges;
+    std::vector<uint64_t> frameHashes;
+
+    // --- Recording ---
+
+    void begin(const vCPU &cpu, uint64_t seed); // Reset and record from cpu at cycle 0.
+    void recordKeys(const vCPU &cpu); // Call after the keypad may have changed, only real changes are stored.
+
+    // Cycles left before the next frame ends, run at most this many before calling recordFrame().
+    [[nodiscard]] unsigned long long cyclesToFrameEnd(const vCPU &cpu) const;
+    void recordFrame(const vCPU &cpu); // Store the hash if cpu sits exactly at the end of a frame.
+
+    bool save(const char *path) const;
+    bool load(const char *path); // False if the file is missing, truncated or of another version.
+
+    // --- Replay ---
+
+    struct Result {
+        uint64_t frames = 0; // Frames replayed.
+        uint64_t mismatchFrame = UINT64_MAX; // First frame whose hash differs, UINT64_MAX if none did.
+        bool romMatches = true;
+    };
+
+    // Replay every recorded frame into cpu, which must hold the ROM at cycle 0. The vCPU is reseeded, set to the
+    // recorded cycles per frame and run through run(cycles), so the caller chooses the engine. Stops at the first
+    // mismatch.
+    Result replay(vCPU &cpu, const std::function<void(unsigned long long)> &run) const;
+
+    static uint64_t frameHash(const vCPU &cpu);
+    static uint64_t memoryHash(const vCPU &cpu);
+    static uint16_t keyMask(const vCPU &cpu);
+
+private:
+    uint16_t lastKeys = 0;
+};
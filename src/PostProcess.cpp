@@ -0,0 +1,171 @@
+#include "PostProcess.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CHIP8_POSTPROCESS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+    // Blend two RGBA values channel by channel, weight out of 255 towards b.
+    uint32_t mix(const uint32_t a, const uint32_t b, const unsigned int weight) {
+        uint32_t out = 0;
+        for (unsigned int shift = 0; shift < 32; shift += 8) {
+            const unsigned int from = a >> shift & 0xFFu;
+            const unsigned int to = b >> shift & 0xFFu;
+            out |= (from * (255 - weight) + to * weight + 127) / 255 << shift;
+        }
+        return out;
+    }
+
+    // Darken the colour channels, leaving alpha (the top byte in memory order RGBA) alone.
+    uint32_t dim(const uint32_t color, const unsigned int level) {
+        return (mix(0, color, level) & 0x00FFFFFFu) | (color & 0xFF000000u);
+    }
+
+    void fill(uint32_t *out, const uint32_t color, const unsigned int count) {
+#ifdef CHIP8_POSTPROCESS_SSE2
+        if (count >= 4) {
+            // Four at a time, the last store overlapping the previous one rather than a scalar tail.
+            const __m128i pixels = _mm_set1_epi32(static_cast<int>(color));
+            for (unsigned int i = 0; i + 4 <= count; i += 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), pixels);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + count - 4), pixels);
+            return;
+        }
+#endif
+        std::fill(out, out + count, color);
+    }
+}
+
+PostProcess::PostProcess(const unsigned int width, const unsigned int height, const unsigned int planes,
+                         const PostProcessSettings &settings) :
+    width(width),
+    height(height),
+    planes(planes),
+    settings(settings),
+    brightness(planes * width * height),
+    shade(width)
+{
+    for (unsigned int index = 0; index < 256; ++index) {
+        if (planes == 1) {
+            palette[index] = mix(settings.off, settings.on, index);
+        } else {
+            // Low nibble the first plane's brightness, high nibble the second's, blended between the four colours.
+            const unsigned int first = (index & 0xFu) * 17;
+            const unsigned int second = (index >> 4u) * 17;
+            palette[index] = mix(mix(settings.off, settings.on, first), mix(settings.second, settings.both, first),
+                                 second);
+        }
+        dimPalette[index] = dim(palette[index], settings.scanline);
+    }
+    setScale(settings.scale);
+}
+
+void PostProcess::setScale(const unsigned int scale) {
+    settings.scale = std::max(1u, scale);
+    image.assign(static_cast<size_t>(outputWidth()) * outputHeight(), palette[0]);
+    redrawAll = true;
+}
+
+PostProcess::Rows PostProcess::process(const uint64_t *video, const uint64_t dirty) {
+    const unsigned int rowWords = width / 64;
+    unsigned int first = height;
+    unsigned int last = 0;
+
+    for (unsigned int y = 0; y < height; ++y) {
+        const uint64_t bit = uint64_t{1} << y;
+        bool changed = redrawAll;
+        // A clean row that has settled would decay to itself, so skip expanding it.
+        if ((dirty | fadingRows) & bit) {
+            bool fading = false;
+            for (unsigned int p = 0; p < planes; ++p) {
+                decayRow(video + (p * height + y) * rowWords, &brightness[(p * height + y) * width], changed, fading);
+            }
+            fadingRows = fading ? fadingRows | bit : fadingRows & ~bit;
+        }
+        if (changed) {
+            drawRow(y);
+            first = std::min(first, y);
+            last = y;
+        }
+    }
+    redrawAll = false;
+
+    if (first > last) {
+        return {};
+    }
+    return {first * settings.scale, (last - first + 1) * settings.scale};
+}
+
+void PostProcess::decayRow(const uint64_t *row, uint8_t *level, bool &changed, bool &fading) const {
+    for (unsigned int word = 0; word < width / 64; ++word) {
+        const uint64_t bits = row[word];
+        uint8_t *out = level + word * 64;
+
+#ifdef CHIP8_POSTPROCESS_SSE2
+        // 16 pixels at a time: spread their two bytes over the lanes, test one bit per lane to get 0xFF where lit,
+        // scale the old brightness by persistence in 16-bit lanes and take the lit mask over it.
+        const __m128i bitOfLane = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i persistence = _mm_set1_epi16(settings.persistence);
+        const __m128i zero = _mm_setzero_si128();
+        for (unsigned int x = 0; x < 64; x += 16) {
+            const unsigned int pair = static_cast<unsigned int>(bits >> (48u - x)) & 0xFFFFu;
+            __m128i spread = _mm_cvtsi32_si128(static_cast<int>(pair >> 8u | (pair & 0xFFu) << 8u));
+            spread = _mm_unpacklo_epi8(spread, spread);
+            spread = _mm_unpacklo_epi16(spread, spread);
+            spread = _mm_unpacklo_epi32(spread, spread);
+            const __m128i lit = _mm_cmpeq_epi8(_mm_and_si128(spread, bitOfLane), bitOfLane);
+
+            const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i *>(out + x));
+            const __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(old, zero), persistence), 8);
+            const __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(old, zero), persistence), 8);
+            const __m128i next = _mm_or_si128(_mm_packus_epi16(low, high), lit);
+
+            changed |= _mm_movemask_epi8(_mm_cmpeq_epi8(next, old)) != 0xFFFF;
+            fading |= _mm_movemask_epi8(_mm_cmpeq_epi8(next, lit)) != 0xFFFF; // Lit lanes are 255, the rest 0 once settled.
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), next);
+        }
+#else
+        for (unsigned int x = 0; x < 64; ++x) {
+            const auto next = static_cast<uint8_t>(bits >> (63u - x) & 1u ? 255 : out[x] * settings.persistence >> 8u);
+            changed |= next != out[x];
+            fading |= next != 0 && next != 255;
+            out[x] = next;
+        }
+#endif
+    }
+}
+
+void PostProcess::drawRow(const unsigned int y) {
+    const unsigned int scale = settings.scale;
+    const unsigned int stride = outputWidth();
+    const uint8_t *level = &brightness[y * width];
+    if (planes == 2) {
+        const uint8_t *second = &brightness[(height + y) * width];
+        for (unsigned int x = 0; x < width; ++x) {
+            shade[x] = static_cast<uint8_t>(level[x] >> 4u | (second[x] & 0xF0u));
+        }
+        level = shade.data();
+    }
+    uint32_t *top = &image[static_cast<size_t>(y) * scale * stride];
+
+    // Build the block's first row, copy it down, then the scanline row if there is one.
+    for (unsigned int x = 0; x < width; ++x) {
+        fill(top + x * scale, palette[level[x]], scale);
+    }
+    const bool scanline = settings.scanline < 255 && scale > 1;
+    const unsigned int plain = scanline ? scale - 1 : scale;
+    for (unsigned int r = 1; r < plain; ++r) {
+        std::memcpy(top + r * stride, top, stride * sizeof(uint32_t));
+    }
+    if (scanline) {
+        uint32_t *bottom = top + (scale - 1) * stride;
+        for (unsigned int x = 0; x < width; ++x) {
+            fill(bottom + x * scale, dimPalette[level[x]], scale);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct PostProcessSettings {
+    unsigned int scale = 8; // Output pixels per display pixel, each way.
+    uint8_t persistence = 0; // Brightness an unlit pixel keeps per frame, out of 256. 0 turns pixels off at once.
+    uint8_t scanline = 255; // Brightness of the bottom row of each block, out of 255. 255 draws no scanlines.
+    uint32_t on = 0xFFFFFFFF; // RGBA bytes in memory order of a lit pixel, on the first plane only with two.
+    uint32_t off = 0xFF282828; // And of an unlit one.
+    uint32_t second = 0xFF2A8CFF; // Two planes: lit on the second plane only.
+    uint32_t both = 0xFF55DCFF; // Two planes: lit on both.
+};
+
+// Turns 1-bit display frames into a scaled RGBA image on the CPU, so the frontend uploads a finished texture
+// once per frame instead of leaving scaling to the GPU. Unlit pixels fade out over a few frames (phosphor
+// persistence, which hides the flicker of XOR-redrawn sprites), each source pixel becomes a scale x scale
+// block, and the bottom row of every block can be dimmed as a scanline. Only rows whose brightness changed are
+// redrawn, and they are reported so just those are uploaded. Rows the caller marks unchanged are not even
+// expanded once they have finished fading. With two planes (XO-CHIP) each fades on its own and the pixel colour
+// blends the four plane colours, at 16 brightness steps per plane.
+class PostProcess {
+public:
+    // Rows [first, first + count) of the output that changed in the last process().
+    struct Rows {
+        unsigned int first = 0;
+        unsigned int count = 0;
+    };
+
+    // A width x height display of 1 or 2 planes, width a multiple of 64 and height at most 64, rows of width / 64
+    // words with x = 0 in the top bit, planes one after the other as in BasicCPU::video.
+    PostProcess(unsigned int width, unsigned int height, unsigned int planes, const PostProcessSettings &settings = {});
+
+    void setScale(unsigned int scale); // Resizes the output and redraws all of it on the next process().
+
+    // Blend one frame into the image. Call once per displayed frame, fading goes on while the display is still.
+    // Bit y of dirty clear promises row y is the same as last call on every plane, like vCPU::dirtyRows.
+    Rows process(const uint64_t *video, uint64_t dirty = ~uint64_t{0});
+
+    [[nodiscard]] const uint32_t *pixels() const { return image.data(); }
+    [[nodiscard]] unsigned int outputWidth() const { return width * settings.scale; }
+    [[nodiscard]] unsigned int outputHeight() const { return height * settings.scale; }
+
+private:
+    // One display row into brightness, noting whether it changed and whether any pixel is still fading.
+    void decayRow(const uint64_t *row, uint8_t *level, bool &changed, bool &fading) const;
+    void drawRow(unsigned int y); // Scale one display row of brightness into the image.
+
+    unsigned int width;
+    unsigned int height;
+    unsigned int planes;
+    PostProcessSettings settings;
+    bool redrawAll = true;
+    uint64_t fadingRows = ~uint64_t{0}; // Rows with pixels between off and fully lit, which decay even when clean.
+
+    std::vector<uint8_t> brightness; // Per display pixel of each plane, 255 while lit.
+    std::vector<uint8_t> shade; // One row of palette indices, the brightness or with two planes both nibbles.
+    uint32_t palette[256]{}; // RGBA for each shade.
+    uint32_t dimPalette[256]{}; // The same on scanline rows.
+    std::vector<uint32_t> image; // outputWidth() x outputHeight() RGBA, reused across frames.
+};
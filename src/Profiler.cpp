@@ -0,0 +1,236 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+#include "Disassembler.h"
+#include "vCPU.h"
+
+namespace {
+    double percent(const uint64_t part, const uint64_t total) {
+        return total > 0 ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+    }
+}
+
+const char *Profiler::opName(const unsigned int op) {
+    switch (static_cast<vCPU::Op>(op)) {
+        case vCPU::Op::OP_00E0: return "00E0";
+        case vCPU::Op::OP_00EE: return "00EE";
+        case vCPU::Op::OP_1nnn: return "1nnn";
+        case vCPU::Op::OP_2nnn: return "2nnn";
+        case vCPU::Op::OP_3xnn: return "3xnn";
+        case vCPU::Op::OP_4xnn: return "4xnn";
+        case vCPU::Op::OP_5xy0: return "5xy0";
+        case vCPU::Op::OP_6xnn: return "6xnn";
+        case vCPU::Op::OP_7xnn: return "7xnn";
+        case vCPU::Op::OP_8xy0: return "8xy0";
+        case vCPU::Op::OP_8xy1: return "8xy1";
+        case vCPU::Op::OP_8xy2: return "8xy2";
+        case vCPU::Op::OP_8xy3: return "8xy3";
+        case vCPU::Op::OP_8xy4: return "8xy4";
+        case vCPU::Op::OP_8xy5: return "8xy5";
+        case vCPU::Op::OP_8xy6: return "8xy6";
+        case vCPU::Op::OP_8xy7: return "8xy7";
+        case vCPU::Op::OP_8xyE: return "8xyE";
+        case vCPU::Op::OP_9xy0: return "9xy0";
+        case vCPU::Op::OP_Annn: return "Annn";
+        case vCPU::Op::OP_Bnnn: return "Bnnn";
+        case vCPU::Op::OP_Cxnn: return "Cxnn";
+        case vCPU::Op::OP_Dxyn: return "Dxyn";
+        case vCPU::Op::OP_Ex9E: return "Ex9E";
+        case vCPU::Op::OP_ExA1: return "ExA1";
+        case vCPU::Op::OP_Fx07: return "Fx07";
+        case vCPU::Op::OP_Fx0A: return "Fx0A";
+        case vCPU::Op::OP_Fx15: return "Fx15";
+        case vCPU::Op::OP_Fx18: return "Fx18";
+        case vCPU::Op::OP_Fx1E: return "Fx1E";
+        case vCPU::Op::OP_Fx29: return "Fx29";
+        case vCPU::Op::OP_Fx33: return "Fx33";
+        case vCPU::Op::OP_Fx55: return "Fx55";
+        case vCPU::Op::OP_Fx65: return "Fx65";
+        case vCPU::Op::OP_00Cn: return "00Cn";
+        case vCPU::Op::OP_00FB: return "00FB";
+        case vCPU::Op::OP_00FC: return "00FC";
+        case vCPU::Op::OP_00FD: return "00FD";
+        case vCPU::Op::OP_00FE: return "00FE";
+        case vCPU::Op::OP_00FF: return "00FF";
+        case vCPU::Op::OP_Fx30: return "Fx30";
+        case vCPU::Op::OP_Fx75: return "Fx75";
+        case vCPU::Op::OP_Fx85: return "Fx85";
+        case vCPU::Op::OP_00Dn: return "00Dn";
+        case vCPU::Op::OP_5xy2: return "5xy2";
+        case vCPU::Op::OP_5xy3: return "5xy3";
+        case vCPU::Op::OP_F000: return "F000";
+        case vCPU::Op::OP_Fn01: return "Fn01";
+        case vCPU::Op::OP_F002: return "F002";
+        case vCPU::Op::OP_Fx3A: return "Fx3A";
+        case vCPU::Op::OP_NULL:
+        case vCPU::Op::BlockEnd:
+            break;
+    }
+    return "invalid";
+}
+
+Profiler::Profiler(const size_t memorySize, const unsigned int cyclesPerFrame, const uint64_t startCycle) :
+    cyclesPerFrame(cyclesPerFrame),
+    addressMask(static_cast<unsigned int>(memorySize - 1)),
+    startCycle(startCycle),
+    frames(FRAME_HISTORY),
+    pcCounts(memorySize)
+{
+}
+
+Profiler::Frame &Profiler::frameAt(const uint64_t cycle) {
+    const uint64_t frame = cycle / cyclesPerFrame - startCycle / cyclesPerFrame;
+    if (frame >= frameEnd) {
+        // Reuse the slots of the frames that fall out, at most the whole ring however far ahead frame is.
+        const uint64_t fresh = std::min(frame + 1 - frameEnd, FRAME_HISTORY);
+        for (uint64_t f = frame + 1 - fresh; f <= frame; ++f) {
+            Frame &slot = frames[f % FRAME_HISTORY];
+            retire(slot);
+            slot = Frame{};
+        }
+        frameEnd = frame + 1;
+    } else if (frame + FRAME_HISTORY < frameEnd) {
+        return stale;
+    }
+    return frames[frame % FRAME_HISTORY];
+}
+
+void Profiler::retire(const Frame &frame) {
+    maxDraws = std::max(maxDraws, frame.draws);
+    maxRows = std::max(maxRows, frame.rows);
+}
+
+uint64_t Profiler::lastFrame(const uint64_t endCycle) const {
+    return endCycle > startCycle ? (endCycle - 1) / cyclesPerFrame : startCycle / cyclesPerFrame;
+}
+
+void Profiler::skippedWait(const unsigned int pc, uint64_t cycle, const uint64_t cycles) {
+    pcCounts[pc & addressMask] += cycles;
+    skippedCycles += cycles;
+
+    // A long wait can cover several frames, each gets its share.
+    const uint64_t end = cycle + cycles;
+    while (cycle < end) {
+        const uint64_t part = std::min(end, (cycle / cyclesPerFrame + 1) * cyclesPerFrame) - cycle;
+        frameAt(cycle).skipped += part;
+        cycle += part;
+    }
+}
+
+void Profiler::draw(const uint64_t cycle, const unsigned int rows) {
+    Frame &frame = frameAt(cycle);
+    ++frame.draws;
+    frame.rows += rows;
+    ++totalDraws;
+    totalRows += rows;
+}
+
+void Profiler::report(std::ostream &out, const uint8_t *memory, const uint64_t endCycle,
+                      const unsigned int hotSpots) const {
+    const uint64_t cycles = endCycle - startCycle;
+    uint64_t counted = skippedCycles;
+    for (const uint64_t count : opCounts) {
+        counted += count;
+    }
+    const uint64_t frameCount = lastFrame(endCycle) - startCycle / cyclesPerFrame + 1;
+
+    out << "Profile: " << cycles << " cycles over " << frameCount << " frames, " << skippedCycles
+            << " of them in skipped delay-timer waits";
+    if (counted < cycles) {
+        out << ", " << cycles - counted << " in blocks (not counted below)";
+    }
+    out << "\n\n";
+
+    // Opcode classes, busiest first.
+    std::vector<unsigned int> ops;
+    for (unsigned int op = 0; op < OP_CLASSES; ++op) {
+        if (opCounts[op] > 0) {
+            ops.push_back(op);
+        }
+    }
+    std::sort(ops.begin(), ops.end(), [this](const unsigned int a, const unsigned int b) {
+        return opCounts[a] > opCounts[b];
+    });
+
+    out << "Opcode class       Count      %\n" << std::fixed << std::setprecision(2);
+    for (const unsigned int op : ops) {
+        out << "  " << std::left << std::setw(10) << opName(op) << std::right << std::setw(12)
+                << opCounts[op] << std::setw(7) << percent(opCounts[op], counted) << "\n";
+    }
+    if (skippedCycles > 0) {
+        out << "  " << std::left << std::setw(10) << "wait" << std::right << std::setw(12) << skippedCycles
+                << std::setw(7) << percent(skippedCycles, counted) << "\n";
+    }
+
+    // Hottest addresses, disassembled from memory as it is now.
+    std::vector<unsigned int> addresses;
+    for (unsigned int address = 0; address < pcCounts.size(); ++address) {
+        if (pcCounts[address] > 0) {
+            addresses.push_back(address);
+        }
+    }
+    const size_t shown = std::min<size_t>(hotSpots, addresses.size());
+    std::partial_sort(addresses.begin(), addresses.begin() + static_cast<std::ptrdiff_t>(shown), addresses.end(),
+                      [this](const unsigned int a, const unsigned int b) { return pcCounts[a] > pcCounts[b]; });
+
+    out << "\nAddress        Count      %  Opcode  Instruction\n";
+    for (size_t i = 0; i < shown; ++i) {
+        const unsigned int address = addresses[i];
+        const auto word = [&](const unsigned int at) {
+            return static_cast<uint16_t>(memory[at & addressMask] << 8u | memory[(at + 1) & addressMask]);
+        };
+        const uint16_t opcode = word(address);
+
+        out << "  " << std::hex << std::uppercase << std::setfill('0') << std::setw(4) << address << std::dec
+                << std::setfill(' ') << std::setw(13) << pcCounts[address] << std::setw(7)
+                << percent(pcCounts[address], counted) << "  " << std::hex << std::setfill('0') << std::setw(4)
+                << opcode << std::dec << std::setfill(' ') << "    " << disassemble(opcode, word(address + 2)) << "\n";
+    }
+
+    // Sprites drawn per frame.
+    uint32_t mostDraws = maxDraws;
+    uint32_t mostRows = maxRows;
+    for (const Frame &frame : frames) {
+        mostDraws = std::max(mostDraws, frame.draws);
+        mostRows = std::max(mostRows, frame.rows);
+    }
+    out << "\nDraws: " << totalDraws << " sprites, " << totalRows << " rows, per frame avg "
+            << static_cast<double>(totalDraws) / static_cast<double>(frameCount) << " sprites / "
+            << static_cast<double>(totalRows) / static_cast<double>(frameCount) << " rows, max " << mostDraws << " / "
+            << mostRows << "\n";
+    out << std::defaultfloat;
+}
+
+void Profiler::writeCSV(std::ostream &out, const uint64_t endCycle) const {
+    out << "frame,cycles,skipped,draws,rows\n";
+
+    // Frames with no draws or waits were never touched, they are written as all cycles and nothing else. Only the
+    // frames still in the ring are written, which is all of them for runs up to FRAME_HISTORY frames.
+    const uint64_t firstFrame = startCycle / cyclesPerFrame;
+    const uint64_t last = lastFrame(endCycle);
+    const uint64_t first = std::max(firstFrame, last + 1 >= FRAME_HISTORY ? last + 1 - FRAME_HISTORY : 0);
+    for (uint64_t frame = first; frame <= last; ++frame) {
+        const uint64_t begin = std::max(startCycle, frame * cyclesPerFrame);
+        const uint64_t end = std::min(endCycle, (frame + 1) * cyclesPerFrame);
+        const Frame counts = frame - firstFrame < frameEnd ? frames[(frame - firstFrame) % FRAME_HISTORY] : Frame{};
+        out << frame << "," << end - begin << "," << counts.skipped << "," << counts.draws << "," << counts.rows
+                << "\n";
+    }
+}
+
+bool Profiler::write(const char *prefix, const uint8_t *memory, const uint64_t endCycle) const {
+    std::ofstream text(std::string(prefix) + ".txt");
+    std::ofstream csv(std::string(prefix) + ".csv");
+    if (!text.is_open() || !csv.is_open()) {
+        return false;
+    }
+
+    report(text, memory, endCycle);
+    writeCSV(csv, endCycle);
+    return text.good() && csv.good();
+}
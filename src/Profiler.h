@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Instruction-level profile of a vCPU, built only with CHIP8_PROFILE. Once attached through vCPU::profiler, run()
+// counts every instruction it executes by opcode class and by address, and every sprite Dxyn draws, frame by
+// frame. Blocks run by the BlockEngine bypass run(), so their instructions are not counted by class or address.
+class Profiler {
+public:
+    static constexpr unsigned int OP_CLASSES = 64; // Room for every vCPU::Op.
+
+    // Per-frame counters kept for the CSV, about 18 minutes at 60Hz in 1MB. The report's totals cover every frame.
+    static constexpr uint64_t FRAME_HISTORY = 1 << 16;
+
+    // Profile from cycle startCycle on, frames being cyclesPerFrame cycles long as in the vCPU.
+    Profiler(size_t memorySize, unsigned int cyclesPerFrame, uint64_t startCycle = 0);
+
+    // Counters run() bumps per instruction, by address and by vCPU::Op. It fetches the arrays once per call so
+    // counting costs two increments, everything per frame is worked out from cycle numbers on rarer events.
+    [[nodiscard]] uint64_t *addressCounts() { return pcCounts.data(); }
+    [[nodiscard]] uint64_t *opClassCounts() { return opCounts; }
+
+    // Cycles of a delay-timer wait at pc that run() jumped over, starting at cycle. They count as time spent at pc.
+    void skippedWait(unsigned int pc, uint64_t cycle, uint64_t cycles);
+    void draw(uint64_t cycle, unsigned int rows); // A Dxyn of rows rows executed at cycle.
+
+    // Opcode classes and the hottest addresses by count, each address disassembled from memory, then draw counts.
+    // endCycle is vCPU::cycleCount when the run ended.
+    void report(std::ostream &out, const uint8_t *memory, uint64_t endCycle, unsigned int hotSpots = 32) const;
+    // frame,cycles,skipped,draws,rows, one line per frame for the last FRAME_HISTORY frames.
+    void writeCSV(std::ostream &out, uint64_t endCycle) const;
+
+    // Write the report to prefix.txt and the CSV to prefix.csv. False if either cannot be written.
+    bool write(const char *prefix, const uint8_t *memory, uint64_t endCycle) const;
+
+private:
+    struct Frame {
+        uint64_t skipped = 0;
+        uint32_t draws = 0;
+        uint32_t rows = 0;
+    };
+
+    Frame &frameAt(uint64_t cycle); // Counters of the frame cycle falls in, which must not be behind the history.
+    void retire(const Frame &frame); // Fold a frame leaving the history into the run's maximums.
+    [[nodiscard]] uint64_t lastFrame(uint64_t endCycle) const; // Frame the last cycle before endCycle fell in.
+    static const char *opName(unsigned int op);
+
+    unsigned int cyclesPerFrame;
+    unsigned int addressMask;
+    uint64_t startCycle;
+    std::vector<Frame> frames; // Ring of FRAME_HISTORY frames, frame f (from startCycle's) at f % FRAME_HISTORY.
+    uint64_t frameEnd = 0; // One past the newest frame in the ring.
+    Frame stale; // Where counts for frames already out of the history go.
+    uint64_t totalDraws = 0;
+    uint64_t totalRows = 0;
+    uint32_t maxDraws = 0; // Of frames retired from the ring, report() adds the ones still in it.
+    uint32_t maxRows = 0;
+    std::vector<uint64_t> pcCounts;
+    uint64_t opCounts[OP_CLASSES]{};
+    uint64_t skippedCycles = 0;
+};
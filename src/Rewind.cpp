@@ -0,0 +1,142 @@
+#include "Rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "vCPU.h"
+
+namespace {
+    constexpr size_t WORDS = sizeof(SaveState) / sizeof(uint64_t);
+    static_assert(sizeof(SaveState) % sizeof(uint64_t) == 0);
+
+    uint64_t word(const SaveState &state, const size_t i) {
+        uint64_t w;
+        std::memcpy(&w, reinterpret_cast<const uint8_t *>(&state) + i * sizeof(w), sizeof(w));
+        return w;
+    }
+}
+
+Rewind::Rewind(const size_t maxBytes, const size_t maxFrames) :
+    buffer(std::max(maxBytes, MAX_DELTA)),
+    entries(std::max<size_t>(maxFrames, 1)),
+    scratch(MAX_DELTA)
+{
+}
+
+size_t Rewind::footprint() const {
+    return buffer.size() + entries.size() * sizeof(Entry) + scratch.size() + sizeof(*this);
+}
+
+void Rewind::clear() {
+    head = 0;
+    count = 0;
+    used = 0;
+    writePos = 0;
+    hasCurrent = false;
+}
+
+void Rewind::capture(const vCPU &cpu) {
+    if (!hasCurrent) {
+        cpu.saveState(current);
+        hasCurrent = true;
+        return;
+    }
+
+    cpu.saveState(next);
+    const size_t size = encode(current, next, scratch.data());
+    std::memcpy(&current, &next, sizeof(current));
+
+    if (count == entries.size()) {
+        dropOldest();
+    }
+
+    // Deltas are laid out in order, so everything at or after writePos is older than everything before it.
+    if (writePos + size > buffer.size()) {
+        while (count > 0 && entries[head].offset >= writePos) {
+            dropOldest();
+        }
+        writePos = 0;
+    }
+    while (count > 0 && entries[head].offset >= writePos && entries[head].offset < writePos + size) {
+        dropOldest();
+    }
+
+    std::memcpy(&buffer[writePos], scratch.data(), size);
+    entries[(head + count) % entries.size()] = Entry{static_cast<uint32_t>(writePos), static_cast<uint32_t>(size)};
+    ++count;
+    used += size;
+    writePos += size;
+}
+
+bool Rewind::stepBack(vCPU &cpu) {
+    if (count == 0) {
+        return false;
+    }
+
+    const Entry &entry = entries[(head + count - 1) % entries.size()];
+    decode(current, &buffer[entry.offset], entry.size);
+    writePos = entry.offset;
+    used -= entry.size;
+    --count;
+
+    return cpu.loadState(current);
+}
+
+void Rewind::dropOldest() {
+    used -= entries[head].size;
+    head = (head + 1) % entries.size();
+    --count;
+}
+
+// Delta layout: pairs of (zero words, literal words) as uint16_t, each followed by its literal XOR words.
+size_t Rewind::encode(const SaveState &from, const SaveState &to, uint8_t *out) {
+    uint8_t *const begin = out;
+
+    size_t i = 0;
+    while (i < WORDS) {
+        const size_t zeroStart = i;
+        while (i < WORDS && word(from, i) == word(to, i)) {
+            ++i;
+        }
+        if (i == WORDS) {
+            break;
+        }
+
+        const size_t literalStart = i;
+        while (i < WORDS && word(from, i) != word(to, i)) {
+            ++i;
+        }
+
+        const uint16_t run[2] = {static_cast<uint16_t>(literalStart - zeroStart), static_cast<uint16_t>(i - literalStart)};
+        std::memcpy(out, run, sizeof(run));
+        out += sizeof(run);
+        for (size_t w = literalStart; w < i; ++w) {
+            const uint64_t x = word(from, w) ^ word(to, w);
+            std::memcpy(out, &x, sizeof(x));
+            out += sizeof(x);
+        }
+    }
+
+    return out - begin;
+}
+
+void Rewind::decode(SaveState &state, const uint8_t *in, const size_t size) {
+    auto *bytes = reinterpret_cast<uint8_t *>(&state);
+    const uint8_t *const end = in + size;
+
+    size_t i = 0;
+    while (in < end) {
+        uint16_t run[2];
+        std::memcpy(run, in, sizeof(run));
+        in += sizeof(run);
+
+        i += run[0];
+        for (unsigned int w = 0; w < run[1]; ++w, ++i) {
+            uint64_t x;
+            std::memcpy(&x, in, sizeof(x));
+            in += sizeof(x);
+            x ^= word(state, i);
+            std::memcpy(bytes + i * sizeof(x), &x, sizeof(x));
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "SaveState.h"
+#include "vCPU.h"
+
+// Bounded history of vCPU states for stepping back frame by frame.
+// Each capture stores the XOR of the new state with the previous one, zero runs collapsed, in a ring buffer
+// allocated up front. The newest state is kept whole, and stepping back XORs the newest delta out of it. Once
+// the buffer or the frame limit is full the oldest frames are dropped.
+class Rewind {
+public:
+    Rewind(size_t maxBytes, size_t maxFrames);
+
+    void capture(const vCPU &cpu); // Record the current state, call once per frame.
+    bool stepBack(vCPU &cpu); // Restore the frame before the newest one, false when the history is empty.
+    void clear();
+
+    [[nodiscard]] size_t frames() const { return count; } // Frames that can be stepped back.
+    [[nodiscard]] size_t bytesUsed() const { return used; } // Bytes of deltas held.
+    [[nodiscard]] size_t footprint() const; // Everything allocated, in bytes.
+
+    // Largest encoded delta: a token per word plus every word changed.
+    static constexpr size_t MAX_DELTA = sizeof(SaveState) / 8 * (2 * sizeof(uint16_t) + 8);
+
+private:
+    struct Entry {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    static size_t encode(const SaveState &from, const SaveState &to, uint8_t *out);
+    static void decode(SaveState &state, const uint8_t *in, size_t size);
+
+    void dropOldest();
+
+    std::vector<uint8_t> buffer;
+    std::vector<Entry> entries; // Ring of deltas, oldest at head.
+    std::vector<uint8_t> scratch;
+    size_t head = 0;
+    size_t count = 0;
+    size_t used = 0;
+    size_t writePos = 0; // Where the next delta goes in buffer.
+
+    SaveState current; // Newest state.
+    SaveState next;
+    bool hasCurrent = false;
+};
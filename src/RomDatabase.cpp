@@ -0,0 +1,58 @@
+#include "RomDatabase.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace {
+    constexpr const char *NAMES[] = {"modern", "vip", "chip48", "schip", "xochip"};
+}
+
+const char *profileName(const Profile profile) {
+    return NAMES[static_cast<unsigned int>(profile)];
+}
+
+bool parseProfile(const char *name, Profile &profile) {
+    for (unsigned int i = 0; i < std::size(NAMES); ++i) {
+        if (std::strcmp(name, NAMES[i]) == 0) {
+            profile = static_cast<Profile>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RomDatabase::load(const char *path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (const size_t comment = line.find('#'); comment != std::string::npos) {
+            line.resize(comment);
+        }
+
+        std::istringstream fields(line);
+        std::string hash, name;
+        Profile profile;
+        if (!(fields >> hash >> name) || hash.size() != 16 || !parseProfile(name.c_str(), profile)) {
+            continue;
+        }
+
+        try {
+            entries[std::stoull(hash, nullptr, 16)] = profile;
+        } catch (const std::exception &) {
+            // Not a hex number, skip the line.
+        }
+    }
+    return true;
+}
+
+Profile RomDatabase::lookup(const uint64_t romHash, const Profile fallback) const {
+    const auto entry = entries.find(romHash);
+    return entry != entries.end() ? entry->second : fallback;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// Machine and quirk combination a ROM runs on, each one a BasicCPU instantiation.
+enum class Profile : uint8_t {
+    Modern, // BasicCPU<Chip8>, i.e. vCPU.
+    Vip, // BasicCPU<Chip8, VipQuirks>.
+    Chip48, // BasicCPU<Chip8, Chip48Quirks>.
+    SuperChip, // BasicCPU<SuperChip>.
+    XoChip // BasicCPU<XoChip>.
+};
+
+const char *profileName(Profile profile); // "modern", "vip", "chip48", "schip" or "xochip".
+bool parseProfile(const char *name, Profile &profile); // False if name is none of the above.
+
+// ROMs that need a profile other than modern, keyed by hash64() of the ROM, see RomImage::hash.
+// Entries come from a text file, one "<hash as 16 hex digits> <profile> [title]" per line, # starts a comment.
+class RomDatabase {
+public:
+    static constexpr const char *DEFAULT_PATH = "assets/romdb.txt";
+
+    bool load(const char *path); // Add the entries in a file. False if it cannot be read, bad lines are skipped.
+
+    // Profile for a ROM by RomImage::hash, fallback when it is not listed.
+    [[nodiscard]] Profile lookup(uint64_t romHash, Profile fallback = Profile::Modern) const;
+
+    [[nodiscard]] size_t size() const { return entries.size(); }
+
+private:
+    std::unordered_map<uint64_t, Profile> entries;
+};
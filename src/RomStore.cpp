@@ -0,0 +1,225 @@
+#include "RomStore.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Hash.h"
+
+// A whole file mapped read-only, or read into a buffer where mapping is not possible.
+struct RomStore::Mapping {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    bool open(const std::string &path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER length;
+        if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &length) && length.QuadPart > 0) {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (view != nullptr) {
+                data = static_cast<const uint8_t *>(view);
+                size = static_cast<size_t>(length.QuadPart);
+                return true;
+            }
+        }
+#else
+        if (const int fd = ::open(path.c_str(), O_RDONLY); fd >= 0) {
+            struct stat info{};
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void *address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) {
+                    view = address;
+                    data = static_cast<const uint8_t *>(address);
+                    size = static_cast<size_t>(info.st_size);
+                }
+            }
+            ::close(fd); // The mapping keeps the file open.
+            if (view != nullptr) {
+                return true;
+            }
+        }
+#endif
+
+        // Not mappable, e.g. a pipe or an empty file, so read it instead.
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream.is_open()) {
+            return false;
+        }
+        copy.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        data = copy.data();
+        size = copy.size();
+        return true;
+    }
+
+    ~Mapping() {
+#ifdef _WIN32
+        if (view != nullptr) {
+            UnmapViewOfFile(view);
+        }
+        if (mapping != nullptr) {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE) {
+            CloseHandle(file);
+        }
+#else
+        if (view != nullptr) {
+            munmap(view, size);
+        }
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+    void *view = nullptr;
+    std::vector<uint8_t> copy;
+};
+
+namespace {
+    constexpr size_t BLOCK = 512; // tar headers and member data are padded to whole blocks.
+
+    // Octal number field of a tar header, terminated by a NUL or space.
+    bool octal(const uint8_t *field, const size_t length, size_t &value) {
+        size_t i = 0;
+        while (i < length && field[i] == ' ') {
+            ++i;
+        }
+        if (i == length || field[i] < '0' || field[i] > '7') {
+            return false;
+        }
+        value = 0;
+        for (; i < length && field[i] >= '0' && field[i] <= '7'; ++i) {
+            value = value << 3u | (field[i] - '0');
+        }
+        return i == length || field[i] == '\0' || field[i] == ' ';
+    }
+
+    // Sum of the header bytes with the checksum field counted as spaces.
+    bool checksumMatches(const uint8_t *header) {
+        size_t stored;
+        if (!octal(header + 148, 8, stored)) {
+            return false;
+        }
+        size_t sum = 8 * ' ';
+        for (size_t i = 0; i < BLOCK; ++i) {
+            sum += i >= 148 && i < 156 ? 0 : header[i];
+        }
+        return sum == stored;
+    }
+
+    std::string field(const uint8_t *text, const size_t length) {
+        const auto *chars = reinterpret_cast<const char *>(text);
+        return {chars, strnlen(chars, length)};
+    }
+}
+
+RomStore::RomStore() = default;
+
+RomStore::~RomStore() = default;
+
+const RomImage *RomStore::load(const std::string &spec) {
+    if (const auto rom = roms.find(spec); rom != roms.end()) {
+        return &rom->second;
+    }
+
+    if (const size_t split = spec.find(".tar:"); split != std::string::npos) {
+        if (!loadPack(spec.substr(0, split + 4))) {
+            return nullptr;
+        }
+        const auto rom = roms.find(spec);
+        return rom != roms.end() ? &rom->second : nullptr;
+    }
+
+    auto mapping = map(spec);
+    if (mapping == nullptr || mapping->size == 0 || mapping->size > MAX_ROM_SIZE) {
+        return nullptr;
+    }
+    add(spec, mapping->data, mapping->size);
+    mappings.push_back(std::move(mapping));
+    return &roms.at(spec);
+}
+
+bool RomStore::loadPack(const std::string &path) {
+    if (packs.contains(path)) {
+        return true;
+    }
+
+    auto mapping = map(path);
+    if (mapping == nullptr) {
+        return false;
+    }
+
+    // Check every header before adding any member, so a corrupt pack adds nothing.
+    struct Member {
+        std::string name;
+        size_t offset;
+        size_t size;
+    };
+    std::vector<Member> members;
+    static constexpr uint8_t END[BLOCK]{};
+
+    for (size_t offset = 0; offset + BLOCK <= mapping->size;) {
+        const uint8_t *header = mapping->data + offset;
+        if (std::memcmp(header, END, BLOCK) == 0) {
+            break;
+        }
+
+        size_t size;
+        if (!checksumMatches(header) || !octal(header + 124, 12, size) || size > mapping->size - offset - BLOCK) {
+            return false;
+        }
+
+        // Regular files only; directories, links and pax headers are stepped over.
+        if (const char type = static_cast<char>(header[156]); (type == '0' || type == '\0') && size > 0 &&
+                                                              size <= MAX_ROM_SIZE) {
+            std::string name = field(header, 100);
+            if (std::memcmp(header + 257, "ustar", 5) == 0 && header[345] != '\0') {
+                name = field(header + 345, 155) + "/" + name;
+            }
+            members.push_back({std::move(name), offset + BLOCK, size});
+        }
+        offset += BLOCK + (size + BLOCK - 1) / BLOCK * BLOCK;
+    }
+
+    for (const auto &member : members) {
+        add(path + ":" + member.name, mapping->data + member.offset, member.size);
+    }
+    mappings.push_back(std::move(mapping));
+    packs.insert(path);
+    return true;
+}
+
+std::vector<const RomImage *> RomStore::images() const {
+    std::vector<const RomImage *> images;
+    images.reserve(roms.size());
+    for (const auto &rom : roms) {
+        images.push_back(&rom.second);
+    }
+    return images;
+}
+
+std::unique_ptr<RomStore::Mapping> RomStore::map(const std::string &path) {
+    auto mapping = std::make_unique<Mapping>();
+    return mapping->open(path) ? std::move(mapping) : nullptr;
+}
+
+void RomStore::add(const std::string &name, const uint8_t *data, const size_t size) {
+    roms[name] = RomImage{name, data, size, hash64(data, size)};
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+// A ROM held by a RomStore, read-only and shared by every vCPU loaded from it.
+struct RomImage {
+    std::string name; // Path it was loaded by, "pack.tar:member" for a ROM in a pack.
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    uint64_t hash = 0; // hash64() of the data, the key RomDatabase looks profiles up by.
+};
+
+// Maps ROM files and tar packs of ROMs into memory once, so loading the same ROM into another vCPU is a single
+// memcpy with no file access. Images stay valid as long as the store.
+class RomStore {
+public:
+    // Largest ROM any machine can hold, XO-CHIP memory above 0x200. Each vCPU checks its own limit on load.
+    static constexpr size_t MAX_ROM_SIZE = 65536 - 0x200;
+
+    RomStore();
+    ~RomStore();
+
+    RomStore(const RomStore &) = delete;
+    RomStore &operator=(const RomStore &) = delete;
+
+    // A ROM file, or "pack.tar:member" for a ROM in a tar pack, mapped on first use. nullptr if the file cannot be
+    // read, the pack is malformed or has no such member, or the ROM is empty or larger than MAX_ROM_SIZE.
+    const RomImage *load(const std::string &spec);
+
+    // Map a tar pack and add every regular file in it as "pack.tar:member". False if it cannot be read or a header
+    // is corrupt; members that are empty or too large are left out.
+    bool loadPack(const std::string &path);
+
+    [[nodiscard]] std::vector<const RomImage *> images() const; // Every ROM loaded so far, in name order.
+
+private:
+    struct Mapping;
+
+    static std::unique_ptr<Mapping> map(const std::string &path);
+    void add(const std::string &name, const uint8_t *data, size_t size);
+
+    std::vector<std::unique_ptr<Mapping>> mappings;
+    std::map<std::string, RomImage> roms;
+    std::set<std::string> packs;
+};
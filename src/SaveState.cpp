@@ -0,0 +1,87 @@
+#include "SaveState.h"
+
+#include <bit>
+#include <cstring>
+
+#include "vCPU.h"
+
+namespace {
+    // Delta layout: header, then every changed page and row in ascending order, then the tail of SaveState.
+    struct DeltaHeader {
+        uint16_t version;
+        uint16_t pages; // One bit per memory page present.
+        uint32_t rows; // One bit per display row present.
+    };
+
+    constexpr size_t TAIL_OFFSET = offsetof(SaveState, index);
+    constexpr size_t TAIL_SIZE = sizeof(SaveState) - TAIL_OFFSET;
+
+    void append(std::vector<uint8_t> &out, const void *data, const size_t size) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+}
+
+size_t DeltaEncoder::encode(const vCPU &cpu, std::vector<uint8_t> &out) {
+    SaveState current;
+    cpu.saveState(current);
+
+    DeltaHeader header{SaveState::VERSION, 0, 0};
+    for (unsigned int p = 0; p < SaveState::PAGES; ++p) {
+        const size_t offset = p * SaveState::PAGE_SIZE;
+        if (std::memcmp(&current.memory[offset], &previous.memory[offset], SaveState::PAGE_SIZE) != 0) {
+            header.pages |= 1u << p;
+        }
+    }
+    for (unsigned int y = 0; y < 32; ++y) {
+        if (current.video[y] != previous.video[y]) {
+            header.rows |= 1u << y;
+        }
+    }
+
+    const size_t begin = out.size();
+    out.reserve(begin + sizeof(header) + std::popcount(header.pages) * SaveState::PAGE_SIZE +
+                std::popcount(header.rows) * sizeof(uint64_t) + TAIL_SIZE);
+
+    append(out, &header, sizeof(header));
+    for (unsigned int pages = header.pages; pages != 0; pages &= pages - 1) {
+        append(out, &current.memory[std::countr_zero(pages) * SaveState::PAGE_SIZE], SaveState::PAGE_SIZE);
+    }
+    for (uint32_t rows = header.rows; rows != 0; rows &= rows - 1) {
+        append(out, &current.video[std::countr_zero(rows)], sizeof(uint64_t));
+    }
+    append(out, reinterpret_cast<const uint8_t *>(&current) + TAIL_OFFSET, TAIL_SIZE);
+
+    previous = current;
+    return out.size() - begin;
+}
+
+size_t DeltaEncoder::apply(SaveState &state, const uint8_t *delta, const size_t size) {
+    DeltaHeader header{};
+    if (size < sizeof(header)) {
+        return 0;
+    }
+    std::memcpy(&header, delta, sizeof(header));
+
+    const size_t total = sizeof(header) + std::popcount(header.pages) * SaveState::PAGE_SIZE +
+                         std::popcount(header.rows) * sizeof(uint64_t) + TAIL_SIZE;
+    if (header.version != SaveState::VERSION || size < total) {
+        return 0;
+    }
+
+    const uint8_t *in = delta + sizeof(header);
+    for (unsigned int pages = header.pages; pages != 0; pages &= pages - 1) {
+        std::memcpy(&state.memory[std::countr_zero(pages) * SaveState::PAGE_SIZE], in, SaveState::PAGE_SIZE);
+        in += SaveState::PAGE_SIZE;
+    }
+    for (uint32_t rows = header.rows; rows != 0; rows &= rows - 1) {
+        std::memcpy(&state.video[std::countr_zero(rows)], in, sizeof(uint64_t));
+        in += sizeof(uint64_t);
+    }
+    std::memcpy(reinterpret_cast<uint8_t *>(&state) + TAIL_OFFSET, in, TAIL_SIZE);
+
+    state.magic = SaveState::MAGIC;
+    state.version = SaveState::VERSION;
+    state.size = sizeof(SaveState);
+    return total;
+}
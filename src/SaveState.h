@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vCPU.h"
+
+// Fixed-size binary snapshot of a vCPU, written by vCPU::saveState() and read by vCPU::loadState().
+// Plain data in host byte order, so it can be copied, stored or written to disk as is.
+struct SaveState {
+    static constexpr uint32_t MAGIC = 0x53533843; // "C8SS" in little-endian.
+    static constexpr uint16_t VERSION = 2;
+    static constexpr unsigned int PAGE_SIZE = 256; // Granularity of memory in a delta.
+    static constexpr unsigned int PAGES = 4096 / PAGE_SIZE;
+
+    uint32_t magic = MAGIC;
+    uint16_t version = VERSION;
+    uint16_t size = 0; // sizeof(SaveState), set when saved.
+
+    uint64_t video[32]{};
+    uint8_t memory[4096]{};
+
+    // Everything from here on is small and always stored whole in a delta.
+    uint16_t index = 0;
+    uint16_t pc = 0;
+    uint16_t stack[16]{};
+    uint8_t registers[16]{};
+    uint8_t keypad[16]{};
+    uint8_t sp = 0;
+    uint8_t delayTimer = 0;
+    uint8_t soundTimer = 0;
+    uint8_t flags = 0; // Bit 0: the vCPU wraps sprites (WRAP_SPRITES quirk), informational.
+    uint64_t cycles = 0; // vCPU::cycleCount.
+    uint64_t rng = 0; // Random generator state.
+};
+
+static_assert(sizeof(SaveState) == 4448, "SaveState layout changed, bump SaveState::VERSION");
+
+// Stores each snapshot as the difference to the one before it: the 256-byte memory pages and display rows that
+// changed, plus registers, timers and the rest in full. Decoding starts from a default SaveState, so the first
+// delta carries every non-zero page and row.
+class DeltaEncoder {
+public:
+    // Append the delta from the previous snapshot to out and return its size in bytes.
+    size_t encode(const vCPU &cpu, std::vector<uint8_t> &out);
+
+    // Start over as if nothing had been encoded yet.
+    void reset() { previous = SaveState(); }
+
+    // Apply one delta to the snapshot it was taken against. Returns the bytes consumed, 0 if it is malformed.
+    static size_t apply(SaveState &state, const uint8_t *delta, size_t size);
+
+private:
+    SaveState previous;
+};
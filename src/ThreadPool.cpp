@@ -0,0 +1,105 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(const unsigned int threads) {
+    const unsigned int count = std::max(threads, 1u);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned int i = 1; i < count; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(const size_t count, const size_t grain, const std::function<void(size_t, size_t)> &fn) {
+    if (count == 0) {
+        return;
+    }
+
+    const size_t step = std::max<size_t>(grain, 1);
+    const size_t chunks = (count + step - 1) / step;
+
+    job = &fn;
+    pending.store(chunks, std::memory_order_release);
+
+    // Deal chunks out round robin, neighbouring chunks land on different workers.
+    for (size_t c = 0; c < chunks; ++c) {
+        Queue &queue = *queues[c % queues.size()];
+        std::lock_guard lock(queue.mutex);
+        queue.ranges.push_back(Range{c * step, std::min(count, (c + 1) * step)});
+    }
+
+    {
+        std::lock_guard lock(wakeMutex);
+        ++generation;
+    }
+    wake.notify_all();
+
+    while (pending.load(std::memory_order_acquire) != 0) {
+        if (!runOne(0)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::runOne(const unsigned int self) {
+    Range range{};
+    bool found = false;
+
+    for (unsigned int i = 0; i < queues.size() && !found; ++i) {
+        Queue &queue = *queues[(self + i) % queues.size()];
+        std::lock_guard lock(queue.mutex);
+
+        if (!queue.ranges.empty()) {
+            // Own work from the front, stolen work from the back.
+            if (i == 0) {
+                range = queue.ranges.front();
+                queue.ranges.pop_front();
+            } else {
+                range = queue.ranges.back();
+                queue.ranges.pop_back();
+            }
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    (*job)(range.begin, range.end);
+    pending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void ThreadPool::workerLoop(const unsigned int self) {
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock lock(wakeMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        while (runOne(self)) {
+        }
+    }
+}
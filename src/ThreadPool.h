@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running parallel loops.
+// Each worker has its own queue of index ranges and steals from the others once it runs dry, so uneven chunks
+// balance out. The calling thread works too.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    [[nodiscard]] unsigned int size() const { return static_cast<unsigned int>(queues.size()); }
+
+    // Call fn(begin, end) over [0, count) in chunks of at most grain, returning once every chunk has run.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(unsigned int self);
+    bool runOne(unsigned int self); // Run one range from our own queue or a stolen one, false when all are empty.
+
+    std::vector<std::unique_ptr<Queue>> queues; // Queue 0 belongs to the calling thread.
+    std::vector<std::thread> workers;
+
+    const std::function<void(size_t, size_t)> *job = nullptr;
+    std::atomic<size_t> pending{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    uint64_t generation = 0;
+    bool stopping = false;
+};
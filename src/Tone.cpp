@@ -0,0 +1,113 @@
+#include "Tone.h"
+
+#include <cmath>
+
+ToneGenerator::ToneGenerator(const float frequency, const int16_t amplitude) :
+    amplitude(amplitude)
+{
+    setSquare(frequency);
+}
+
+void ToneGenerator::setSquare(const float frequency) {
+    patternHigh.store(~uint64_t{0}, std::memory_order_relaxed);
+    patternLow.store(0, std::memory_order_relaxed);
+    setBitRate(frequency * 128.0);
+}
+
+void ToneGenerator::setPattern(const uint8_t pattern[16], const uint8_t pitch) {
+    uint64_t high = 0;
+    uint64_t low = 0;
+    for (unsigned int i = 0; i < 8; ++i) {
+        high = high << 8u | pattern[i];
+        low = low << 8u | pattern[i + 8];
+    }
+    patternHigh.store(high, std::memory_order_relaxed);
+    patternLow.store(low, std::memory_order_relaxed);
+    setBitRate(4000.0 * std::exp2((pitch - 64) / 48.0));
+}
+
+void ToneGenerator::setBitRate(const double bitsPerSecond) {
+    step.store(static_cast<uint32_t>(bitsPerSecond / SAMPLE_RATE * 65536.0), std::memory_order_relaxed);
+}
+
+void ToneGenerator::fill(int16_t *out, const size_t count) {
+    if (!gate.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = 0;
+        }
+        return;
+    }
+
+    const uint64_t high = patternHigh.load(std::memory_order_relaxed);
+    const uint64_t low = patternLow.load(std::memory_order_relaxed);
+    const uint32_t advance = step.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned int bit = phase >> 16u & 127u;
+        const uint64_t word = bit < 64 ? high : low;
+        out[i] = word >> (63u - bit % 64u) & 1u ? amplitude : static_cast<int16_t>(-amplitude);
+        phase = (phase + advance) & ((128u << 16u) - 1u);
+    }
+}
+
+// --- WAV Output ---
+
+namespace {
+    void put16(FILE *file, const uint16_t value) {
+        const uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8u)};
+        std::fwrite(bytes, 1, sizeof(bytes), file);
+    }
+
+    void put32(FILE *file, const uint32_t value) {
+        put16(file, static_cast<uint16_t>(value));
+        put16(file, static_cast<uint16_t>(value >> 16u));
+    }
+
+    void writeHeader(FILE *file, const unsigned int sampleRate, const size_t samples) {
+        const auto dataBytes = static_cast<uint32_t>(samples * sizeof(int16_t));
+        std::fwrite("RIFF", 1, 4, file);
+        put32(file, 36 + dataBytes);
+        std::fwrite("WAVEfmt ", 1, 8, file);
+        put32(file, 16); // PCM format chunk.
+        put16(file, 1); // PCM.
+        put16(file, 1); // Mono.
+        put32(file, sampleRate);
+        put32(file, sampleRate * sizeof(int16_t));
+        put16(file, sizeof(int16_t));
+        put16(file, 16);
+        std::fwrite("data", 1, 4, file);
+        put32(file, dataBytes);
+    }
+}
+
+bool WavWriter::open(const char *path, const unsigned int sampleRate) {
+    close();
+    file = std::fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    this->sampleRate = sampleRate;
+    samples = 0;
+    writeHeader(file, sampleRate, 0); // Sizes are filled in by close().
+    return true;
+}
+
+void WavWriter::write(const int16_t *data, const size_t count) {
+    if (file == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        put16(file, static_cast<uint16_t>(data[i]));
+    }
+    samples += count;
+}
+
+void WavWriter::close() {
+    if (file == nullptr) {
+        return;
+    }
+    std::fseek(file, 0, SEEK_SET);
+    writeHeader(file, sampleRate, samples);
+    std::fclose(file);
+    file = nullptr;
+}
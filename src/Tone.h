@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Beeper for the sound timer. Plays a looping 128-bit pattern, a square wave by default or an XO-CHIP audio
+// pattern, while the gate is open. The emulator sets the gate and pattern from its thread, fill() runs on the
+// audio thread without locking or allocating, and samples the gate once per buffer.
+class ToneGenerator {
+public:
+    static constexpr unsigned int SAMPLE_RATE = 44100;
+
+    explicit ToneGenerator(float frequency = 440.0f, int16_t amplitude = 6000);
+
+    void setGate(const bool open) { gate.store(open, std::memory_order_relaxed); }
+    [[nodiscard]] bool gateOpen() const { return gate.load(std::memory_order_relaxed); }
+
+    void setSquare(float frequency); // 50% duty square wave.
+    void setPattern(const uint8_t pattern[16], uint8_t pitch); // XO-CHIP: 4000 * 2^((pitch - 64) / 48) bits/sec.
+
+    void fill(int16_t *out, size_t count); // Next count mono samples.
+
+private:
+    void setBitRate(double bitsPerSecond);
+
+    std::atomic<bool> gate{false};
+    std::atomic<uint64_t> patternHigh; // Bits 0-63, most significant first.
+    std::atomic<uint64_t> patternLow; // Bits 64-127.
+    std::atomic<uint32_t> step; // Pattern bits per sample, 16.16 fixed point.
+    uint32_t phase = 0; // Position in the pattern, 7.16 fixed point. Audio thread only.
+    int16_t amplitude;
+};
+
+// Minimal 16-bit mono PCM WAV file writer, the file backend for headless runs.
+class WavWriter {
+public:
+    WavWriter() = default;
+    ~WavWriter() { close(); }
+
+    WavWriter(const WavWriter &) = delete;
+    WavWriter &operator=(const WavWriter &) = delete;
+
+    bool open(const char *path, unsigned int sampleRate);
+    void write(const int16_t *samples, size_t count);
+    void close(); // Finish the header, called by the destructor too.
+
+    [[nodiscard]] size_t samplesWritten() const { return samples; }
+
+private:
+    FILE *file = nullptr;
+    unsigned int sampleRate = 0;
+    size_t samples = 0;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer, single consumer handoff of the newest complete value.
+// The producer fills back() and publishes it, the consumer always sees the most recently published value and
+// never one that is still being written. Values published while the consumer is busy are skipped.
+template<typename T>
+class TripleBuffer {
+public:
+    // Producer side.
+    T &back() { return slots[backIndex]; }
+
+    void publish() {
+        backIndex = middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Consumer side. Takes the newest published value if there is one, returns false when front() is unchanged.
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T &front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4; // Set on the middle index when it holds a value the consumer has not taken.
+
+    T slots[3]{};
+    uint8_t backIndex = 0;
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t frontIndex = 2;
+};
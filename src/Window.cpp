@@ -1,70 +1,93 @@
 #include "Window.h"
+#include "FrameScheduler.h"
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 
 
-// https://github.com/SFML/SFML/wiki/Source%3A-Letterbox-effect-using-a-view#the-function
-sf::View getLetterboxView(sf::View view, const int windowWidth, const int windowHeight) {
-    // Compares the aspect ratio of the window to the aspect ratio of the view,
-    // and sets the view's viewport accordingly in order to achieve a letterbox effect.
-    // A new view (with a new viewport set) is returned.
-
-    const float windowRatio = static_cast<float>(windowWidth) / static_cast<float>(windowHeight);
-    const float viewRatio = view.getSize().x / static_cast<float>(view.getSize().y);
-    float sizeX = 1;
-    float sizeY = 1;
-    float posX = 0;
-    float posY = 0;
-
-    bool horizontalSpacing = true;
-    if (windowRatio < viewRatio)
-        horizontalSpacing = false;
-
-    // If horizontalSpacing is true, the black bars will appear on the left and right side.
-    // Otherwise, the black bars will appear on the top and bottom.
-
-    if (horizontalSpacing) {
-        sizeX = viewRatio / windowRatio;
-        posX = (1 - sizeX) / 2.f;
-    } else {
-        sizeY = windowRatio / viewRatio;
-        posY = (1 - sizeY) / 2.f;
-    }
-
-    view.setViewport(sf::FloatRect(posX, posY, sizeX, sizeY));
-
-    return view;
-}
-
 // ReSharper disable twice CppDFAConstantConditions - vSync
 // ReSharper disable once CppDFAUnreachableCode - vSync
-Window::Window() :
-    mWindow(sf::VideoMode(512, 512, 1), "CHIP8 Emulator", sf::Style::Default)
+template <typename CPU>
+BasicWindow<CPU>::BasicWindow(const RomImage &rom, const WindowSettings &settings) :
+    TPS_Limit(static_cast<int>(settings.cyclesPerFrame) * FPS_Limit),
+    mWindow(sf::VideoMode(512, 512, 1), "CHIP8 Emulator", sf::Style::Default),
+    mPost(CPU::WIDTH, CPU::HEIGHT, CPU::PLANES, {1, settings.persistence, settings.scanline}),
+    settings(settings),
+    mRewind(settings.rewindMemory, static_cast<size_t>(settings.rewindSeconds) * FPS_Limit)
 {
     const auto mode = sf::VideoMode(512, 512, 1); //sf::VideoMode::getDesktopMode();
     std::cout << "Using resolution: " << mode.width << "x" << mode.height << " - " << mode.bitsPerPixel << " bpp" <<
             std::endl;
-    std::cout << "FPS Limit: " << FPS_Limit << std::endl;
-    mView.setSize(66, 34);
-    mView.setCenter(mView.getSize().x / 2, mView.getSize().y / 2);
-    mView = getLetterboxView(mView, mode.width, mode.height); // NOLINT(*-narrowing-conversions)
+    std::cout << "FPS Limit: " << FPS_Limit << " (turbo preview " << settings.previewFPS << ")" << std::endl;
+    std::cout << "Instructions per frame: " << settings.cyclesPerFrame << " (" << TPS_Limit << "Hz)" << std::endl;
+    if constexpr (MODERN) {
+        if (settings.useBlockEngine) {
+            engine = std::make_unique<BlockEngine>(cpu);
+        }
+        std::cout << "Rewind: " << settings.rewindSeconds << "s, " << mRewind.footprint() / 1024 << " KB (hold Backspace)"
+                << std::endl;
+    } else {
+        std::cout << "Block engine, rewind and recording need the modern profile, they are off." << std::endl;
+        this->settings.useBlockEngine = false;
+        this->settings.recordPath = nullptr;
+    }
+    std::cout << "Engine: " << (this->settings.useBlockEngine ? "block" : "interpreter") <<
+            (settings.threaded ? ", threaded" : "") << std::endl;
 
     mWindow.setVerticalSyncEnabled(false);
     //mWindow.setIcon(100, 100, sf::Image()); // Set the window's icon
 
-    cpu.loadROM("assets/test.2.ch8");
+    resizeOutput(mode.width, mode.height);
+
+    cpu.loadROM(rom.data, rom.size);
+    cpu.cyclesPerFrame = settings.cyclesPerFrame;
+
+    if (settings.audio) {
+        mAudio.play();
+    }
+
+#ifdef CHIP8_PROFILE
+    mProfiler = std::make_unique<Profiler>(CPU::MEMORY, cpu.cyclesPerFrame, cpu.cycleCount);
+    cpu.profiler = mProfiler.get();
+#endif
+
+    if constexpr (MODERN) {
+        if (settings.recordPath != nullptr) {
+            const auto seed = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+            cpu.seed(seed);
+            mMovie.begin(cpu, seed);
+            mRecording = true;
+            std::cout << "Recording to " << settings.recordPath << " (seed " << seed << ")" << std::endl;
+        }
+    }
+}
+
+template <typename CPU>
+BasicWindow<CPU>::~BasicWindow() {
+    if (mEmulationThread.joinable()) {
+        mRunning = false;
+        mEmulationThread.join();
+    }
 }
 
 
 /// Fixed timestep for Rendering and Update
-void Window::loop() {
+template <typename CPU>
+void BasicWindow<CPU>::loop() {
     int frames = 0;
     int ticks = 0;
     sf::Clock frameClock;
 
     double t = 0.0; //
-    const double dt = 1.0 / 600; // Fixed timestep for game logic (vCPU Speed)
-    const double renderDt = 1.0 / static_cast<double>(FPS_Limit); // Fixed timestep for rendering
+    const double dt = 1.0 / static_cast<double>(TPS_Limit); // Fixed timestep for game logic (vCPU Speed)
+
+    FrameScheduler scheduler;
+
+    if (settings.threaded) {
+        mRunning = true;
+        mEmulationThread = std::thread(&BasicWindow::emulationLoop, this);
+    }
 
     auto currentTime = std::chrono::steady_clock::now();
     auto accumulator = std::chrono::duration<double>(0.0);
@@ -79,17 +102,40 @@ void Window::loop() {
         accumulator += frameTime;
         renderAccumulator += frameTime;
 
-        while (accumulator.count() >= dt) {
-            ticks++;
+        // Events are polled once per wake-up, i.e. once per frame, ahead of the ticks they affect.
+        processEvents();
+
+        // Turbo renders at the preview rate, leaving the time in between to the vCPU.
+        const int speed = mSpeed.load(std::memory_order_relaxed);
+        const double renderDt = 1.0 / static_cast<double>(speed == 1 ? FPS_Limit : settings.previewFPS);
 
-            processEvents();
-            update(t, dt);
+        // Ticks that are due run as one batch, so the block engine can execute whole blocks.
+        // In threaded mode the emulation thread keeps its own accumulator instead.
+        unsigned int cycles = 0;
+        while (!settings.threaded && accumulator.count() >= dt) {
+            cycles++;
 
             t += dt;
             accumulator -= std::chrono::duration<double>(dt);
         }
 
+        if (!settings.threaded && !mRewinding.load(std::memory_order_relaxed)) {
+            if (speed == 0) {
+                // Uncapped, run until the next render is due, checking for input at least once per 60Hz frame.
+                const auto untilRender = std::min(std::chrono::duration<double>(renderDt) - renderAccumulator,
+                                                  std::chrono::duration<double>(1.0 / static_cast<double>(FPS_Limit)));
+                ticks += static_cast<int>(runUncapped(
+                    newTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(untilRender)));
+            } else if (cycles > 0) {
+                update(t, cycles * speed);
+                ticks += static_cast<int>(cycles * speed);
+            }
+        }
+
         while (renderAccumulator.count() >= renderDt) {
+            if (!settings.threaded) {
+                recordFrame();
+            }
             render(t);
             frames++;
 
@@ -98,56 +144,268 @@ void Window::loop() {
 
         if (frameClock.getElapsedTime().asSeconds() >= 1.f) {
             frameClock.restart();
+            if (settings.threaded) {
+                ticks = mEmuTicks.exchange(0);
+            }
             FPS = frames;
             TPS = ticks;
-            std::cout << "FPS: " << frames << " TPS: " << ticks << std::endl;
+            renderTime = frames > 0 ? renderSeconds / frames : 0;
+            const auto jitter = scheduler.takeJitter();
+            std::cout << "FPS: " << frames << " TPS: " << ticks << " Speed: " <<
+                    static_cast<double>(ticks) / TPS_Limit << "x" << (speed == 0 ? " (uncapped)" : "") <<
+                    " Render: " << renderTime * 1000.0 << "ms/frame" <<
+                    " Jitter p50/p99/max: " << jitter.p50 << "/" << jitter.p99 << "/" << jitter.max << "us";
+            if (settings.threaded) {
+                const int emuFrames = mEmuFrames.exchange(0);
+                const auto emuBusy = static_cast<double>(mEmuBusyMicroseconds.exchange(0));
+                std::cout << " | Emulation: " << emuFrames << " frames, busy " <<
+                        (emuFrames > 0 ? emuBusy / emuFrames / 1000.0 : 0) << "ms/frame";
+            }
+            const size_t rewindFrames = mRewindFrames.load(std::memory_order_relaxed);
+            std::cout << " | Rewind: " << static_cast<double>(rewindFrames) / FPS_Limit << "s, " <<
+                    mRewindBytes.load(std::memory_order_relaxed) / 1024 << "/" << settings.rewindMemory / 1024 << " KB";
+            if (const int steps = mRewindSteps.exchange(0); steps > 0) {
+                std::cout << ", step back avg/max " << static_cast<double>(mRewindNanoseconds.exchange(0)) / steps / 1000.0
+                        << "/" << static_cast<double>(mRewindWorstNanoseconds.exchange(0)) / 1000.0 << "us";
+            }
+            if (settings.audio) {
+                const Audio::Stats audio = mAudio.takeStats();
+                std::cout << " | Audio: " << audio.callbacks << " callbacks, " << audio.underruns << " underruns, " <<
+                        audio.averageMicroseconds << "/" << audio.maxMicroseconds << "us";
+            }
+            std::cout << std::endl;
             frames = 0;
             ticks = 0;
+            renderSeconds = 0;
+        }
+
+        // Sleep until the next frame is due, ticks that fall due meanwhile run as one batch on wake-up.
+        const auto untilRender = std::chrono::duration<double>(renderDt) - renderAccumulator;
+        scheduler.sleepUntil(currentTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(untilRender));
+    }
+
+    if (mEmulationThread.joinable()) {
+        mRunning = false;
+        mEmulationThread.join();
+    }
+
+    if (mRecording) {
+        if (mMovie.save(settings.recordPath)) {
+            std::cout << "Saved " << mMovie.frameHashes.size() << " frames, " << mMovie.keyChanges.size() <<
+                    " key changes to " << settings.recordPath << std::endl;
+        } else {
+            std::cout << "Error: Failed to save movie " << settings.recordPath << std::endl;
         }
     }
+
+#ifdef CHIP8_PROFILE
+    cpu.profiler = nullptr;
+    if (mProfiler->write("chip8-profile", cpu.memory, cpu.cycleCount)) {
+        std::cout << "Profile written to chip8-profile.txt and chip8-profile.csv" << std::endl;
+    } else {
+        std::cout << "Error: Failed to write profile chip8-profile" << std::endl;
+    }
+#endif
 }
 
 
-void Window::handlePlayerInput(const sf::Keyboard::Key key, const bool isPressed) {
+/// Fixed timestep for Update on the emulation thread, publishing one frame per wake-up.
+template <typename CPU>
+void BasicWindow<CPU>::emulationLoop() {
+    FrameScheduler scheduler;
+
+    double t = 0.0;
+    const double dt = 1.0 / static_cast<double>(TPS_Limit);
+    const auto frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / static_cast<double>(FPS_Limit)));
+
+    auto currentTime = std::chrono::steady_clock::now();
+    auto deadline = currentTime;
+    auto accumulator = std::chrono::duration<double>(0.0);
+
+    while (mRunning.load(std::memory_order_relaxed)) {
+        const auto newTime = std::chrono::steady_clock::now();
+        accumulator += newTime - currentTime;
+        currentTime = newTime;
+
+        KeyEvent event{};
+        while (mInput.pop(event)) {
+            cpu.keypad[event.key] = event.pressed;
+        }
+        // Events that did not fit in the queue are lost in order but not in state: catch up to the newest mask.
+        if (mInputOverflow.exchange(false, std::memory_order_acquire)) {
+            const uint16_t mask = mKeyMask.load(std::memory_order_relaxed);
+            for (unsigned int k = 0; k < 16; ++k) {
+                cpu.keypad[k] = mask >> k & 1u;
+            }
+        }
+        if constexpr (MODERN) {
+            if (mRecording) {
+                mMovie.recordKeys(cpu);
+            }
+        }
+
+        unsigned int cycles = 0;
+        while (accumulator.count() >= dt) {
+            cycles++;
+
+            t += dt;
+            accumulator -= std::chrono::duration<double>(dt);
+        }
+
+        const int speed = mSpeed.load(std::memory_order_relaxed);
+        const bool rewinding = mRewinding.load(std::memory_order_relaxed);
+        unsigned long long ran = 0;
+        if (speed == 0 && !rewinding) {
+            // Uncapped, run for one frame's worth of wall time and publish. The deadline below is then already due.
+            ran = runUncapped(newTime + frameDuration);
+            deadline = std::chrono::steady_clock::now() - frameDuration;
+        } else if (cycles > 0 && !rewinding) {
+            ran = static_cast<unsigned long long>(cycles) * speed;
+            update(t, static_cast<unsigned int>(ran));
+        }
+
+        if (ran > 0 || (cycles > 0 && rewinding)) {
+            recordFrame();
+
+            std::memcpy(mFrames.back().video, cpu.video, sizeof(cpu.video));
+            mFrames.publish();
+            mEmuFrames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        mEmuTicks.fetch_add(static_cast<int>(ran), std::memory_order_relaxed);
+        mEmuBusyMicroseconds.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - newTime).count(), std::memory_order_relaxed);
+
+        // Frames missed by a stall are dropped rather than run back to back.
+        deadline = std::max(deadline + frameDuration, std::chrono::steady_clock::now());
+        scheduler.sleepUntil(deadline);
+    }
+}
+
+
+template <typename CPU>
+unsigned long long BasicWindow<CPU>::runUncapped(const std::chrono::steady_clock::time_point deadline) {
+    unsigned long long cycles = 0;
+    do {
+        update(0, TURBO_BATCH);
+        cycles += TURBO_BATCH;
+    } while (std::chrono::steady_clock::now() < deadline);
+    return cycles;
+}
+
+
+template <typename CPU>
+void BasicWindow<CPU>::recordFrame() {
+    // Rewind keeps vCPU states, other profiles have no history.
+    if constexpr (MODERN) {
+        if (!mRewinding.load(std::memory_order_relaxed)) {
+            mRewind.capture(cpu);
+        } else {
+            mAudio.tone.setGate(false);
+
+            // Keys held now stay held, rather than jumping back to what was pressed in the restored frame.
+            uint8_t keypad[16];
+            std::memcpy(keypad, cpu.keypad, sizeof(keypad));
+
+            const auto start = std::chrono::steady_clock::now();
+            if (mRewind.stepBack(cpu)) {
+                const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                mRewindSteps.fetch_add(1, std::memory_order_relaxed);
+                mRewindNanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+                if (elapsed > mRewindWorstNanoseconds.load(std::memory_order_relaxed)) {
+                    mRewindWorstNanoseconds.store(elapsed, std::memory_order_relaxed);
+                }
+            }
+
+            std::memcpy(cpu.keypad, keypad, sizeof(keypad));
+        }
+
+        mRewindFrames.store(mRewind.frames(), std::memory_order_relaxed);
+        mRewindBytes.store(mRewind.bytesUsed(), std::memory_order_relaxed);
+    }
+}
+
+
+template <typename CPU>
+void BasicWindow<CPU>::handlePlayerInput(const sf::Keyboard::Key key, const bool isPressed) {
+    int pad = -1;
+
     if (key == sf::Keyboard::X) {
-        cpu.keypad[0] = isPressed;
+        pad = 0;
     } else if (key == sf::Keyboard::Num1) {
-        cpu.keypad[1] = isPressed;
+        pad = 1;
     } else if (key == sf::Keyboard::Num2) {
-        cpu.keypad[2] = isPressed;
+        pad = 2;
     } else if (key == sf::Keyboard::Num3) {
-        cpu.keypad[3] = isPressed;
+        pad = 3;
     } else if (key == sf::Keyboard::Q) {
-        cpu.keypad[4] = isPressed;
+        pad = 4;
     } else if (key == sf::Keyboard::W) {
-        cpu.keypad[5] = isPressed;
+        pad = 5;
     } else if (key == sf::Keyboard::E) {
-        cpu.keypad[6] = isPressed;
+        pad = 6;
     } else if (key == sf::Keyboard::A) {
-        cpu.keypad[7] = isPressed;
+        pad = 7;
     } else if (key == sf::Keyboard::S) {
-        cpu.keypad[8] = isPressed;
+        pad = 8;
     } else if (key == sf::Keyboard::D) {
-        cpu.keypad[9] = isPressed;
+        pad = 9;
     } else if (key == sf::Keyboard::Z) {
-        cpu.keypad[0xA] = isPressed;
+        pad = 0xA;
     } else if (key == sf::Keyboard::C) {
-        cpu.keypad[0xB] = isPressed;
+        pad = 0xB;
     } else if (key == sf::Keyboard::Num4) {
-        cpu.keypad[0xC] = isPressed;
+        pad = 0xC;
     } else if (key == sf::Keyboard::R) {
-        cpu.keypad[0xD] = isPressed;
+        pad = 0xD;
     } else if (key == sf::Keyboard::F) {
-        cpu.keypad[0xE] = isPressed;
+        pad = 0xE;
     } else if (key == sf::Keyboard::V) {
-        cpu.keypad[0xF] = isPressed;
+        pad = 0xF;
+    } else if (key == sf::Keyboard::Tab && isPressed) {
+        mSpeed = mSpeed == 1 ? mTurboSpeed : 1;
+    } else if (key >= sf::Keyboard::F1 && key <= sf::Keyboard::F4 && isPressed) {
+        // F1 normal speed, F2 2x, F3 4x, F4 uncapped.
+        const int speeds[4] = {1, 2, 4, 0};
+        mSpeed = speeds[key - sf::Keyboard::F1];
+        if (mSpeed != 1) {
+            mTurboSpeed = mSpeed;
+        }
+    } else if (key == sf::Keyboard::Backspace) {
+        mRewinding = MODERN && isPressed && !mRecording;
     } else if (key == sf::Keyboard::Escape) {
-        exit(0);
+        mWindow.close(); // Leaves loop(), which saves any recording.
+    }
+
+    if (pad < 0) {
+        return;
+    }
+
+    if (settings.threaded) {
+        const auto bit = static_cast<uint16_t>(1u << pad);
+        if (isPressed) {
+            mKeyMask.fetch_or(bit, std::memory_order_relaxed);
+        } else {
+            mKeyMask.fetch_and(static_cast<uint16_t>(~bit), std::memory_order_relaxed);
+        }
+        if (!mInput.push(KeyEvent{static_cast<uint8_t>(pad), isPressed})) {
+            mInputOverflow.store(true, std::memory_order_release);
+        }
+    } else {
+        cpu.keypad[pad] = isPressed;
+        if constexpr (MODERN) {
+            if (mRecording) {
+                mMovie.recordKeys(cpu);
+            }
+        }
     }
 }
 
 
-void Window::processEvents() {
+template <typename CPU>
+void BasicWindow<CPU>::processEvents() {
     sf::Event event{};
     while (mWindow.pollEvent(event)) {
         switch (event.type) {
@@ -160,7 +418,7 @@ void Window::processEvents() {
                     //set height to 132
                     mWindow.setSize(sf::Vector2u(mWindow.getSize().x, 132));
                 }
-                mView = getLetterboxView(mView, event.size.width, event.size.height); // NOLINT(*-narrowing-conversions)
+                resizeOutput(mWindow.getSize().x, mWindow.getSize().y);
                 break;
             case sf::Event::KeyPressed:
                 handlePlayerInput(event.key.code, true);
@@ -178,61 +436,123 @@ void Window::processEvents() {
 }
 
 
-void Window::update(const double time, const double deltaTime) {
-    cpu.cycle();
+template <typename CPU>
+void BasicWindow<CPU>::update(const double time, unsigned int cycles) {
+    while (cycles > 0) {
+        // While recording, batches are split at frame ends so each frame's hash is taken at the exact cycle.
+        unsigned int batch = cycles;
+        if constexpr (MODERN) {
+            if (mRecording) {
+                batch = static_cast<unsigned int>(std::min<unsigned long long>(cycles, mMovie.cyclesToFrameEnd(cpu)));
+            }
+        }
+
+        if (engine) {
+            engine->run(batch);
+        } else {
+            cpu.run(batch);
+        }
+        cycles -= batch;
+
+        if constexpr (MODERN) {
+            if (mRecording) {
+                mMovie.recordFrame(cpu);
+            }
+        }
+    }
+
+    if (cpu.customAudio) {
+        mAudio.tone.setPattern(cpu.audioPattern, cpu.pitch);
+    }
+    mAudio.tone.setGate(cpu.soundTimer() > 0);
 
 #ifndef NDEBUG
-    //std::cout << "[Update] t: " << time << " dt: " << deltaTime << std::endl;
+    //std::cout << "[Update] t: " << time << " cycles: " << cycles << std::endl;
 #endif
 }
 
 
-void Window::render(double time) {
+template <typename CPU>
+void BasicWindow<CPU>::render(double time) {
 #ifndef NDEBUG
     //std::cout << "[Render] t: " << time << std::endl;
 #endif
+    const auto start = std::chrono::steady_clock::now();
+
     mWindow.clear(sf::Color::Black);
-    mWindow.setView(mView);
-
-    //Draw 'background'
-    sf::RectangleShape bg;
-    bg.setSize(sf::Vector2f(66, 34));
-    bg.setFillColor(sf::Color::Cyan);
-    bg.setPosition(0.0f, 0.0f);
-    mWindow.draw(bg);
-
-    //Draw 'game'
-    sf::Texture texture;
-    if(texture.create(64, 32)) {
-        // Little hacky because SFML texture uses RGBA, but CHIP-8 uses 1-bit per pixel (on/off).
-        uint8_t pixels[64*32*4]{20};
-        for(int i = 0; i < 64*32; i++) {
-            if(cpu.video[i] == 1) {
-                // White
-                pixels[i*4] = 255;
-                pixels[i*4+1] = 255;
-                pixels[i*4+2] = 255;
-                pixels[i*4+3] = 255;
-            } else {
-                // Grey
-                pixels[i*4] = 40;
-                pixels[i*4+1] = 40;
-                pixels[i*4+2] = 40;
-                pixels[i*4+3] = 255;
-            }
-        }
 
-        texture.update(pixels, 64, 32, 0, 0);
-    } else {
-        std::cout << "Error: Failed to create texture." << std::endl;
+    //Draw 'game', faded and scaled on the CPU. Only the rows that changed, if any, are uploaded, in one go.
+    // In threaded mode the newest complete frame from the emulation thread is used, or the last one again.
+    // Rows that differ from the last processed frame, so settled ones are not expanded again.
+    uint64_t dirty = 0;
+    if (!settings.threaded) {
+        dirty = cpu.dirtyRows;
+        cpu.dirtyRows = 0;
+    } else if (mFrames.update()) {
+        // Frames can be skipped between updates, so compare with the shown one rather than trusting dirtyRows.
+        const uint64_t *video = mFrames.front().video;
+        for (unsigned int i = 0; i < VIDEO_WORDS; ++i) {
+            dirty |= (video[i] != mShownVideo[i] ? uint64_t{1} : uint64_t{0}) << (i / CPU::ROW_WORDS % CPU::HEIGHT);
+        }
+        std::memcpy(mShownVideo, video, sizeof(mShownVideo));
     }
-
-
-    sf::Sprite sprite(texture);
-    sprite.setPosition(1, 1);
-    mWindow.draw(sprite);
+    const PostProcess::Rows rows = mPost.process(settings.threaded ? mShownVideo : cpu.video, dirty);
+    if (rows.count > 0) {
+        const unsigned int width = mPost.outputWidth();
+        mTexture.update(reinterpret_cast<const uint8_t *>(mPost.pixels() + static_cast<size_t>(rows.first) * width),
+                        width, rows.count, 0, rows.first);
+    }
+    mWindow.draw(mSprite);
 
     //Draw 'Debug/Admin'
 
+    // display() is left out, it can block on vsync or the compositor.
+    renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
     mWindow.display();
 }
+
+
+template <typename CPU>
+void BasicWindow<CPU>::resizeOutput(const unsigned int width, const unsigned int height) {
+    // Whole output pixels per display pixel, so every one is the same size and nothing is filtered.
+    const unsigned int largest = sf::Texture::getMaximumSize() / CPU::WIDTH;
+    const unsigned int scale = std::clamp(std::min(width / CPU::WIDTH, height / CPU::HEIGHT), 1u, std::max(1u, largest));
+    if (scale != mPost.outputWidth() / CPU::WIDTH || mTexture.getSize().x == 0) {
+        mPost.setScale(scale);
+        if (!mTexture.create(mPost.outputWidth(), mPost.outputHeight())) {
+            std::cout << "Error: Failed to create texture." << std::endl;
+        }
+        mSprite.setTexture(mTexture, true);
+    }
+
+    // One view unit per window pixel, the image centred with black around it.
+    mWindow.setView(sf::View(sf::FloatRect(0, 0, static_cast<float>(width), static_cast<float>(height))));
+    mSprite.setPosition(static_cast<float>((static_cast<int>(width) - static_cast<int>(mPost.outputWidth())) / 2),
+                        static_cast<float>((static_cast<int>(height) - static_cast<int>(mPost.outputHeight())) / 2));
+}
+
+
+int runWindow(const RomImage &rom, const Profile profile, const WindowSettings &settings) {
+    // One switch per ROM, after which everything runs on the profile's own instantiation.
+    const auto run = [&]<typename CPU>() {
+        if (rom.size > CPU::MEMORY - CPU::START_ADDRESS) {
+            std::cerr << "ROM is " << rom.size << " bytes, " << profileName(profile) << " has room for "
+                    << CPU::MEMORY - CPU::START_ADDRESS << "." << std::endl;
+            return 1;
+        }
+        std::cout << "Profile: " << profileName(profile) << std::endl;
+        // On the heap, an XO-CHIP vCPU alone is nearly 200KB.
+        const auto window = std::make_unique<BasicWindow<CPU>>(rom, settings);
+        window->loop();
+        return 0;
+    };
+    switch (profile) {
+        case Profile::Vip: return run.operator()<BasicCPU<Chip8, VipQuirks>>();
+        case Profile::Chip48: return run.operator()<BasicCPU<Chip8, Chip48Quirks>>();
+        case Profile::SuperChip: return run.operator()<BasicCPU<SuperChip>>();
+        case Profile::XoChip: return run.operator()<BasicCPU<XoChip>>();
+        case Profile::Modern: break;
+    }
+    return run.operator()<vCPU>();
+}
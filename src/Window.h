@@ -2,34 +2,146 @@
 
 #include <SFML/Graphics.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include "Audio.h"
+#include "BlockEngine.h"
+#include "Movie.h"
+#include "PostProcess.h"
+#include "Rewind.h"
+#include "RomDatabase.h"
+#include "RomStore.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
 #include "vCPU.h"
 
-class Window {
+#ifdef CHIP8_PROFILE
+#include "Profiler.h"
+#endif
+
+struct WindowSettings {
+    bool useBlockEngine = false; // Run the vCPU through the BlockEngine. Modern profile only.
+    bool threaded = false; // Run the vCPU on its own thread, handing frames to the render thread.
+    unsigned int cyclesPerFrame = 10; // vCPU instructions per 60Hz frame, the timers tick at 60Hz regardless.
+    unsigned int rewindSeconds = 30; // History kept for rewinding, at one state per frame.
+    size_t rewindMemory = 4 << 20; // Cap on the rewind buffer in bytes, the oldest frames go first once full.
+    const char *recordPath = nullptr; // Record input to this movie file, saved when the window closes. Modern only.
+    int previewFPS = 15; // Render rate while turbo is on.
+    bool audio = true; // Beep while the sound timer runs.
+    uint8_t persistence = 160; // Phosphor fade, brightness kept per frame out of 256. 0 switches pixels off at once.
+    uint8_t scanline = 255; // Brightness of scanlines out of 255, 255 for none.
+};
+
+// Open a window running rom on the BasicCPU instantiation for profile, until it is closed. Returns the exit status,
+// 1 if the ROM does not fit the profile's memory.
+int runWindow(const RomImage &rom, Profile profile, const WindowSettings &settings = {});
+
+// SFML frontend for one BasicCPU instantiation, picked once per ROM by runWindow(). The block engine, rewind and
+// movie recording work on vCPU states, so other profiles run without them.
+template <typename CPU>
+class BasicWindow {
 public:
-    Window();
+    // rom must fit in CPU memory.
+    explicit BasicWindow(const RomImage &rom, const WindowSettings &settings = {});
+    ~BasicWindow();
 
     void loop();
 
     int getFPS() const { return FPS; }
     int getTPS() const { return TPS; }
+    double getRenderTime() const { return renderTime; } // Average CPU time spent in render() per frame, in seconds.
 
 private:
     void handlePlayerInput(sf::Keyboard::Key key, bool isPressed);
 
     void processEvents();
 
-    void update(double time, double deltaTime);
+    void update(double time, unsigned int cycles);
 
     void render(double time);
 
+    void resizeOutput(unsigned int width, unsigned int height); // Largest integer scale that fits, centred.
+
+    void emulationLoop(); // Body of the emulation thread.
+
+    void recordFrame(); // Step back while rewinding, otherwise capture the frame. Called once per frame.
+
+    // Run the vCPU flat out in batches until the deadline, returning the cycles run.
+    unsigned long long runUncapped(std::chrono::steady_clock::time_point deadline);
+
     //Vars
     int FPS = 0;
     int TPS = 0;
+    double renderTime = 0;
+    double renderSeconds = 0; // CPU time spent in render() since the last stats line.
 
     int FPS_Limit = 60; // CHIP-8 Ran at 60FPS / 60Hz
+    int TPS_Limit = 600; // vCPU ticks per second, cyclesPerFrame * FPS_Limit.
+
+    // Turbo: multiple of TPS_Limit to run at, 0 for as fast as possible. Set from the keyboard.
+    static constexpr unsigned int TURBO_BATCH = 1000; // Cycles between clock checks when uncapped.
+    std::atomic<int> mSpeed{1};
+    int mTurboSpeed = 4; // Speed Tab switches to.
+
+    static constexpr bool MODERN = std::is_same_v<CPU, vCPU>;
 
     sf::RenderWindow mWindow;
-    sf::View mView;
 
-    vCPU cpu;
+    // The display is faded and scaled on the CPU, the texture is window-sized and drawn 1:1.
+    PostProcess mPost;
+    sf::Texture mTexture;
+    sf::Sprite mSprite;
+
+    CPU cpu;
+    std::unique_ptr<BlockEngine> engine; // Modern profile with useBlockEngine only.
+    WindowSettings settings;
+
+    // Rewind history, owned by whichever thread runs the vCPU. Held key sets mRewinding. Modern profile only.
+    Rewind mRewind;
+    std::atomic<bool> mRewinding{false};
+    std::atomic<int> mRewindSteps{0};
+    std::atomic<int64_t> mRewindNanoseconds{0};
+    std::atomic<int64_t> mRewindWorstNanoseconds{0};
+    std::atomic<size_t> mRewindFrames{0};
+    std::atomic<size_t> mRewindBytes{0};
+
+    // Sound output, the gate follows cpu.soundTimer() after every update.
+    Audio mAudio;
+
+    // Movie being recorded, owned by whichever thread runs the vCPU. Rewinding is off while recording.
+    Movie mMovie;
+    bool mRecording = false;
+
+#ifdef CHIP8_PROFILE
+    // Attached to cpu for the whole session, written to chip8-profile.txt/.csv when the window closes.
+    std::unique_ptr<Profiler> mProfiler;
+#endif
+
+    // Threaded mode, the emulation thread owns cpu and engine.
+    static constexpr unsigned int VIDEO_WORDS = CPU::PLANES * CPU::HEIGHT * CPU::ROW_WORDS;
+    struct Frame {
+        uint64_t video[VIDEO_WORDS];
+    };
+
+    struct KeyEvent {
+        uint8_t key;
+        bool pressed;
+    };
+
+    std::thread mEmulationThread;
+    std::atomic<bool> mRunning{false};
+    TripleBuffer<Frame> mFrames;
+    SpscQueue<KeyEvent, 64> mInput;
+    std::atomic<uint16_t> mKeyMask{0}; // Every key's latest state, applied whole when mInput overflowed.
+    std::atomic<bool> mInputOverflow{false};
+    uint64_t mShownVideo[VIDEO_WORDS]{}; // Newest frame received, processed again every render while it fades.
+
+    // Emulation thread stats, read by the render thread once per second.
+    std::atomic<int> mEmuTicks{0};
+    std::atomic<int> mEmuFrames{0};
+    std::atomic<int64_t> mEmuBusyMicroseconds{0};
 };
@@ -1,14 +1,74 @@
+#include "RomStore.h"
 #include "Window.h"
 
-#ifndef NDEBUG
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#endif //NDEBUG
+#include <limits>
 
-int main() {
+int main(int argc, char *argv[]) {
 #ifndef NDEBUG
     std::cerr << "WARNING: Running debug build, expect reduced performance." << std::endl;
 #endif //NDEBUG
 
-    Window window;
-    window.loop();
+    const char *romPath = "assets/test.ch8";
+    const char *romdbPath = RomDatabase::DEFAULT_PATH;
+    bool profileSet = false;
+    Profile profile = Profile::Modern;
+    WindowSettings settings;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--block-engine") == 0) {
+            settings.useBlockEngine = true;
+        } else if (std::strcmp(argv[i], "--threaded") == 0) {
+            settings.threaded = true;
+        } else if (std::strcmp(argv[i], "--rewind-seconds") == 0 && i + 1 < argc) {
+            settings.rewindSeconds = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--rewind-memory") == 0 && i + 1 < argc) {
+            settings.rewindMemory = std::strtoull(argv[++i], nullptr, 10) << 20; // In MB.
+        } else if (std::strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+            // At least 1, and small enough that the window's tick rate, 60 times this, fits an int.
+            settings.cyclesPerFrame = static_cast<unsigned int>(std::clamp(
+                    std::strtoull(argv[++i], nullptr, 10), 1ull,
+                    static_cast<unsigned long long>(std::numeric_limits<int>::max() / 60)));
+        } else if (std::strcmp(argv[i], "--preview-fps") == 0 && i + 1 < argc) {
+            settings.previewFPS = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--mute") == 0) {
+            settings.audio = false;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            settings.recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--persistence") == 0 && i + 1 < argc) {
+            settings.persistence = static_cast<uint8_t>(std::clamp(std::atoi(argv[++i]), 0, 255));
+        } else if (std::strcmp(argv[i], "--scanlines") == 0 && i + 1 < argc) {
+            settings.scanline = static_cast<uint8_t>(std::clamp(std::atoi(argv[++i]), 0, 255));
+        } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (!parseProfile(argv[++i], profile)) {
+                std::cerr << "Unknown profile " << argv[i] << ", expected modern, vip, chip48, schip or xochip."
+                        << std::endl;
+                return 1;
+            }
+            profileSet = true;
+        } else if (std::strcmp(argv[i], "--romdb") == 0 && i + 1 < argc) {
+            romdbPath = argv[++i];
+        } else {
+            romPath = argv[i];
+        }
+    }
+
+    RomStore store;
+    const RomImage *rom = store.load(romPath);
+    if (rom == nullptr) {
+        std::cerr << "Failed to load ROM: " << romPath << std::endl;
+        return 1;
+    }
+
+    // Unless set, the profile comes from the ROM database, modern for ROMs it does not list.
+    if (!profileSet) {
+        RomDatabase database;
+        database.load(romdbPath);
+        profile = database.lookup(rom->hash);
+    }
+
+    return runWindow(*rom, profile, settings);
 }
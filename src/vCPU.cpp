@@ -1,18 +1,22 @@
 #include "vCPU.h"
 
+#include <algorithm>
+#include <bit>
 #include <chrono>
 #include <fstream>
-#include <iostream>
 #include <cstring>
+#include <iterator>
 
-vCPU::vCPU() :
-    randGen(std::chrono::system_clock::now().time_since_epoch().count())
-{
-    randByte = std::uniform_int_distribution<uint8_t>(0, 255);
+#include "SaveState.h"
+
+#ifdef CHIP8_PROFILE
+#include "Profiler.h"
+#endif
 
-    // Load fonts manually into reserved memory space.
+namespace {
+    // Fonts copied into reserved memory space at power-on.
     // https://github.com/mattmikolay/chip-8/wiki/CHIP‐8-Technical-Reference#fonts
-    const uint8_t fontset[80] = {
+    constexpr uint8_t FONT[80] = {
         0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
         0x20, 0x60, 0x20, 0x20, 0x70, // 1
         0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
@@ -30,336 +34,1024 @@ vCPU::vCPU() :
         0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };
-    for (unsigned int i = 0; i < 80; ++i) {
-        memory[0x50 + i] = fontset[i]; // Stored from 0x50 to 0x9F.
-    }
-
-    // Load table of function pointers.
-    table[0x0] = &vCPU::OP_NULL;
-    table[0x1] = &vCPU::OP_1nnn;
-    table[0x2] = &vCPU::OP_2nnn;
-    table[0x3] = &vCPU::OP_3xnn;
-    table[0x4] = &vCPU::OP_4xnn;
-    table[0x5] = &vCPU::OP_5xy0;
-    table[0x6] = &vCPU::OP_6xnn;
-    table[0x7] = &vCPU::OP_7xnn;
-    table[0x8] = &vCPU::OP_8xy0;
-    table[0x9] = &vCPU::OP_9xy0;
-    table[0xA] = &vCPU::OP_Annn;
-    table[0xB] = &vCPU::OP_Bnnn;
-    table[0xC] = &vCPU::OP_Cxnn;
-    table[0xD] = &vCPU::OP_Dxyn;
-    table[0xE] = &vCPU::OP_NULL;
-    table[0xF] = &vCPU::OP_NULL;
-
-    for(size_t i = 0; i <= 0xE; i++) {
-        table0[i] = &vCPU::OP_NULL;
-        table8[i] = &vCPU::OP_NULL;
-        tableE[i] = &vCPU::OP_NULL;
-    }
-
-    table0[0xE] = &vCPU::OP_00EE;
-    table0[0x0] = &vCPU::OP_00E0;
-
-    table8[0x0] = &vCPU::OP_8xy0;
-    table8[0x1] = &vCPU::OP_8xy1;
-    table8[0x2] = &vCPU::OP_8xy2;
-    table8[0x3] = &vCPU::OP_8xy3;
-    table8[0x4] = &vCPU::OP_8xy4;
-    table8[0x5] = &vCPU::OP_8xy5;
-    table8[0x6] = &vCPU::OP_8xy6;
-    table8[0x7] = &vCPU::OP_8xy7;
-    table8[0xE] = &vCPU::OP_8xyE;
-
-    tableE[0x1] = &vCPU::OP_ExA1;
-    tableE[0xE] = &vCPU::OP_Ex9E;
-
-    for(size_t i = 0; i <= 0x65; i++) {
-        tableF[i] = &vCPU::OP_NULL;
-    }
-    tableF[0x07] = &vCPU::OP_Fx07;
-    tableF[0x0A] = &vCPU::OP_Fx0A;
-    tableF[0x15] = &vCPU::OP_Fx15;
-    tableF[0x18] = &vCPU::OP_Fx18;
-    tableF[0x1E] = &vCPU::OP_Fx1E;
-    tableF[0x29] = &vCPU::OP_Fx29;
-    tableF[0x33] = &vCPU::OP_Fx33;
-    tableF[0x55] = &vCPU::OP_Fx55;
-    tableF[0x65] = &vCPU::OP_Fx65;
-}
-
-
-void vCPU::loadROM(const char *filename) {
+
+    // 8x10 digits for Fx30, 0-F as XO-CHIP has them.
+    constexpr uint8_t BIG_FONT[160] = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
+}
+
+template <typename Machine, typename Quirks>
+BasicCPU<Machine, Quirks>::BasicCPU() :
+    BasicCPU(static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()))
+{
+}
+
+template <typename Machine, typename Quirks>
+BasicCPU<Machine, Quirks>::BasicCPU(const uint64_t seed) {
+    this->seed(seed);
+
+    std::memcpy(&memory[0x50], FONT, sizeof(FONT)); // Stored from 0x50 to 0x9F.
+
+    if constexpr (Machine::SUPER) {
+        std::memcpy(&memory[0xA0], BIG_FONT, sizeof(BIG_FONT)); // Stored from 0xA0 to 0x13F.
+    }
+}
+
+template <typename Machine, typename Quirks>
+bool BasicCPU<Machine, Quirks>::loadROM(const char *filename) {
     std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    const std::streamoff size = file.tellg();
+    if (size <= 0 || size > MEMORY - START_ADDRESS) {
+        return false;
+    }
+
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char *>(&memory[START_ADDRESS]), size)) {
+        return false;
+    }
+
+    invalidate(START_ADDRESS, static_cast<unsigned int>(size));
+    return true;
+}
 
-    if (file.is_open()) {
-        const std::streampos size = file.tellg();
-        const auto buffer = new char[size];
+template <typename Machine, typename Quirks>
+bool BasicCPU<Machine, Quirks>::loadROM(const uint8_t *data, const size_t size) {
+    if (size == 0 || size > MEMORY - START_ADDRESS) {
+        return false;
+    }
 
-        file.seekg(0, std::ios::beg);
-        file.read(buffer, size);
-        file.close();
+    std::memcpy(&memory[START_ADDRESS], data, size);
+    invalidate(START_ADDRESS, static_cast<unsigned int>(size));
+    return true;
+}
 
-        for (long i = 0; i < size; ++i) {
-            this->memory[START_ADDRESS + i] = buffer[i];
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::expandVideo(uint32_t *pixels, const uint32_t on, const uint32_t off) const {
+    for (unsigned int y = 0; y < HEIGHT; ++y) {
+        for (unsigned int word = 0; word < ROW_WORDS; ++word) {
+            uint64_t row = 0;
+            for (unsigned int p = 0; p < PLANES; ++p) {
+                row |= video[(p * HEIGHT + y) * ROW_WORDS + word];
+            }
+            for (unsigned int x = 0; x < 64; ++x) {
+                *pixels++ = row >> (63u - x) & 1u ? on : off;
+            }
         }
+    }
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::invalidate(const uint16_t address, const unsigned int length) {
+    if (length == 0) return;
 
-        delete[] buffer;
+    const unsigned int begin = address & ADDRESS_MASK;
+    if (begin + length > sizeof(memory)) {
+        writtenBegin = 0;
+        writtenEnd = sizeof(memory);
     } else {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-        exit(1);
+        writtenBegin = std::min<unsigned int>(writtenBegin, begin);
+        writtenEnd = std::max<unsigned int>(writtenEnd, begin + length);
+    }
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::seed(const uint64_t seed) {
+    // splitmix64 spreads nearby seeds apart and cannot leave the state at 0.
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    randState = (z ^ (z >> 31)) | 1u;
+}
+
+template <typename Machine, typename Quirks>
+uint8_t BasicCPU<Machine, Quirks>::randomByte() {
+    randState ^= randState >> 12;
+    randState ^= randState << 25;
+    randState ^= randState >> 27;
+    return static_cast<uint8_t>((randState * 0x2545F4914F6CDD1Dull) >> 56);
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::saveState(SaveState &state) const requires std::is_same_v<Machine, Chip8> {
+    state.magic = SaveState::MAGIC;
+    state.version = SaveState::VERSION;
+    state.size = sizeof(SaveState);
+
+    std::memcpy(state.video, video, sizeof(video));
+    std::memcpy(state.memory, memory, sizeof(memory));
+    state.index = index;
+    state.pc = pc;
+    std::memcpy(state.stack, stack, sizeof(stack));
+    std::memcpy(state.registers, registers, sizeof(registers));
+    std::memcpy(state.keypad, keypad, sizeof(keypad));
+    state.sp = sp;
+    state.delayTimer = delayTimer();
+    state.soundTimer = soundTimer();
+    state.flags = Quirks::WRAP_SPRITES ? 1 : 0;
+    state.cycles = cycleCount;
+    state.rng = randState;
+}
+
+template <typename Machine, typename Quirks>
+bool BasicCPU<Machine, Quirks>::loadState(const SaveState &state) requires std::is_same_v<Machine, Chip8> {
+    if (state.magic != SaveState::MAGIC || state.version != SaveState::VERSION || state.size != sizeof(SaveState)) {
+        return false;
+    }
+
+    // Only pages that differ are copied and noted as written, so a BlockEngine keeps the blocks elsewhere.
+    for (unsigned int offset = 0; offset < sizeof(memory); offset += SaveState::PAGE_SIZE) {
+        if (std::memcmp(&memory[offset], &state.memory[offset], SaveState::PAGE_SIZE) != 0) {
+            std::memcpy(&memory[offset], &state.memory[offset], SaveState::PAGE_SIZE);
+            invalidate(offset, SaveState::PAGE_SIZE);
+        }
+    }
+
+    std::memcpy(video, state.video, sizeof(video));
+    index = state.index;
+    pc = state.pc;
+    std::memcpy(stack, state.stack, sizeof(stack));
+    std::memcpy(registers, state.registers, sizeof(registers));
+    std::memcpy(keypad, state.keypad, sizeof(keypad));
+    sp = state.sp;
+    cycleCount = state.cycles;
+    setDelayTimer(state.delayTimer);
+    setSoundTimer(state.soundTimer);
+    randState = state.rng != 0 ? state.rng : 1;
+
+    dirtyRows = ALL_ROWS;
+    return true;
+}
+
+template <typename Machine, typename Quirks>
+typename BasicCPU<Machine, Quirks>::Instruction BasicCPU<Machine, Quirks>::decode(const uint16_t opcode) {
+    Instruction ins;
+    ins.x = (opcode & 0x0F00u) >> 8u;
+    ins.y = (opcode & 0x00F0u) >> 4u;
+    ins.nn = opcode & 0x00FFu;
+
+    switch ((opcode & 0xF000u) >> 12u) {
+        case 0x0:
+            ins.op = opcode == 0x00E0 ? Op::OP_00E0 : opcode == 0x00EE ? Op::OP_00EE : Op::OP_NULL;
+            if constexpr (Machine::SUPER) {
+                switch (opcode) {
+                    case 0x00FB: ins.op = Op::OP_00FB; break;
+                    case 0x00FC: ins.op = Op::OP_00FC; break;
+                    case 0x00FD: ins.op = Op::OP_00FD; break;
+                    case 0x00FE: ins.op = Op::OP_00FE; break;
+                    case 0x00FF: ins.op = Op::OP_00FF; break;
+                    default:
+                        if ((opcode & 0xFFF0u) == 0x00C0) {
+                            ins.op = Op::OP_00Cn;
+                        } else if (Machine::XO && (opcode & 0xFFF0u) == 0x00D0) {
+                            ins.op = Op::OP_00Dn;
+                        }
+                        break;
+                }
+            }
+            break;
+        case 0x1: ins.op = Op::OP_1nnn; break;
+        case 0x2: ins.op = Op::OP_2nnn; break;
+        case 0x3: ins.op = Op::OP_3xnn; break;
+        case 0x4: ins.op = Op::OP_4xnn; break;
+        case 0x5:
+            ins.op = Op::OP_5xy0;
+            if constexpr (Machine::XO) {
+                ins.op = ins.n() == 2 ? Op::OP_5xy2 : ins.n() == 3 ? Op::OP_5xy3 : Op::OP_5xy0;
+            }
+            break;
+        case 0x6: ins.op = Op::OP_6xnn; break;
+        case 0x7: ins.op = Op::OP_7xnn; break;
+        case 0x8:
+            switch (opcode & 0x000Fu) {
+                case 0x0: ins.op = Op::OP_8xy0; break;
+                case 0x1: ins.op = Op::OP_8xy1; break;
+                case 0x2: ins.op = Op::OP_8xy2; break;
+                case 0x3: ins.op = Op::OP_8xy3; break;
+                case 0x4: ins.op = Op::OP_8xy4; break;
+                case 0x5: ins.op = Op::OP_8xy5; break;
+                case 0x6: ins.op = Op::OP_8xy6; break;
+                case 0x7: ins.op = Op::OP_8xy7; break;
+                case 0xE: ins.op = Op::OP_8xyE; break;
+                default: ins.op = Op::OP_NULL; break;
+            }
+            break;
+        case 0x9: ins.op = Op::OP_9xy0; break;
+        case 0xA: ins.op = Op::OP_Annn; break;
+        case 0xB: ins.op = Op::OP_Bnnn; break;
+        case 0xC: ins.op = Op::OP_Cxnn; break;
+        case 0xD: ins.op = Op::OP_Dxyn; break;
+        case 0xE:
+            ins.op = ins.nn == 0x9E ? Op::OP_Ex9E : ins.nn == 0xA1 ? Op::OP_ExA1 : Op::OP_NULL;
+            break;
+        case 0xF:
+            switch (ins.nn) {
+                case 0x07: ins.op = Op::OP_Fx07; break;
+                case 0x0A: ins.op = Op::OP_Fx0A; break;
+                case 0x15: ins.op = Op::OP_Fx15; break;
+                case 0x18: ins.op = Op::OP_Fx18; break;
+                case 0x1E: ins.op = Op::OP_Fx1E; break;
+                case 0x29: ins.op = Op::OP_Fx29; break;
+                case 0x33: ins.op = Op::OP_Fx33; break;
+                case 0x55: ins.op = Op::OP_Fx55; break;
+                case 0x65: ins.op = Op::OP_Fx65; break;
+                default: ins.op = Op::OP_NULL; break;
+            }
+            if constexpr (Machine::SUPER) {
+                switch (ins.nn) {
+                    case 0x30: ins.op = Op::OP_Fx30; break;
+                    case 0x75: ins.op = Op::OP_Fx75; break;
+                    case 0x85: ins.op = Op::OP_Fx85; break;
+                    default: break;
+                }
+            }
+            if constexpr (Machine::XO) {
+                if (opcode == 0xF000) {
+                    ins.op = Op::OP_F000;
+                } else if (opcode == 0xF002) {
+                    ins.op = Op::OP_F002;
+                } else if (ins.nn == 0x01) {
+                    ins.op = Op::OP_Fn01;
+                } else if (ins.nn == 0x3A) {
+                    ins.op = Op::OP_Fx3A;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    return ins;
+}
+
+template <typename Machine, typename Quirks>
+inline typename BasicCPU<Machine, Quirks>::Instruction BasicCPU<Machine, Quirks>::fetch() {
+    const unsigned int address = pc & ADDRESS_MASK;
+
+    const unsigned int opcode = memory[address] << 8u | memory[(address + 1) & ADDRESS_MASK];
+    return Instruction{HANDLERS[opcode], static_cast<uint8_t>(opcode >> 8u & 0xFu),
+                       static_cast<uint8_t>(opcode >> 4u & 0xFu), static_cast<uint8_t>(opcode)};
+}
+
+template <typename Machine, typename Quirks>
+const std::array<typename BasicCPU<Machine, Quirks>::Op, 0x10000> BasicCPU<Machine, Quirks>::HANDLERS = [] {
+    std::array<Op, 0x10000> table{};
+    for (unsigned int opcode = 0; opcode < table.size(); ++opcode) {
+        table[opcode] = decode(static_cast<uint16_t>(opcode)).op;
+    }
+    return table;
+}();
+
+template <typename Machine, typename Quirks>
+inline void BasicCPU<Machine, Quirks>::execute(const Instruction ins) {
+    switch (ins.op) {
+        case Op::OP_00E0: OP_00E0(); break;
+        case Op::OP_00EE: OP_00EE(); break;
+        case Op::OP_1nnn: OP_1nnn(ins); break;
+        case Op::OP_2nnn: OP_2nnn(ins); break;
+        case Op::OP_3xnn: OP_3xnn(ins); break;
+        case Op::OP_4xnn: OP_4xnn(ins); break;
+        case Op::OP_5xy0: OP_5xy0(ins); break;
+        case Op::OP_6xnn: OP_6xnn(ins); break;
+        case Op::OP_7xnn: OP_7xnn(ins); break;
+        case Op::OP_8xy0: OP_8xy0(ins); break;
+        case Op::OP_8xy1: OP_8xy1(ins); break;
+        case Op::OP_8xy2: OP_8xy2(ins); break;
+        case Op::OP_8xy3: OP_8xy3(ins); break;
+        case Op::OP_8xy4: OP_8xy4(ins); break;
+        case Op::OP_8xy5: OP_8xy5(ins); break;
+        case Op::OP_8xy6: OP_8xy6(ins); break;
+        case Op::OP_8xy7: OP_8xy7(ins); break;
+        case Op::OP_8xyE: OP_8xyE(ins); break;
+        case Op::OP_9xy0: OP_9xy0(ins); break;
+        case Op::OP_Annn: OP_Annn(ins); break;
+        case Op::OP_Bnnn: OP_Bnnn(ins); break;
+        case Op::OP_Cxnn: OP_Cxnn(ins); break;
+        case Op::OP_Dxyn: OP_Dxyn(ins); break;
+        case Op::OP_Ex9E: OP_Ex9E(ins); break;
+        case Op::OP_ExA1: OP_ExA1(ins); break;
+        case Op::OP_Fx07: OP_Fx07(ins); break;
+        case Op::OP_Fx0A: OP_Fx0A(ins); break;
+        case Op::OP_Fx15: OP_Fx15(ins); break;
+        case Op::OP_Fx18: OP_Fx18(ins); break;
+        case Op::OP_Fx1E: OP_Fx1E(ins); break;
+        case Op::OP_Fx29: OP_Fx29(ins); break;
+        case Op::OP_Fx33: OP_Fx33(ins); break;
+        case Op::OP_Fx55: OP_Fx55(ins); break;
+        case Op::OP_Fx65: OP_Fx65(ins); break;
+        case Op::OP_00Cn: OP_00Cn(ins); break;
+        case Op::OP_00FB: OP_00FB(); break;
+        case Op::OP_00FC: OP_00FC(); break;
+        case Op::OP_00FD: OP_00FD(); break;
+        case Op::OP_00FE: OP_00FE(); break;
+        case Op::OP_00FF: OP_00FF(); break;
+        case Op::OP_Fx30: OP_Fx30(ins); break;
+        case Op::OP_Fx75: OP_Fx75(ins); break;
+        case Op::OP_Fx85: OP_Fx85(ins); break;
+        case Op::OP_00Dn: OP_00Dn(ins); break;
+        case Op::OP_5xy2: OP_5xy2(ins); break;
+        case Op::OP_5xy3: OP_5xy3(ins); break;
+        case Op::OP_F000: OP_F000(); break;
+        case Op::OP_Fn01: OP_Fn01(ins); break;
+        case Op::OP_F002: OP_F002(); break;
+        case Op::OP_Fx3A: OP_Fx3A(ins); break;
+        case Op::OP_NULL:
+        case Op::BlockEnd: // Never decoded, only BlockEngine steps carry it.
+            OP_NULL();
+            break;
     }
 }
 
 // F-D-E Cycle
-void vCPU::cycle() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::cycle() {
     //cycles at like 600Hz
+    run(1);
+}
 
-    // Fetch
-    opcode = memory[pc] << 8u | memory[pc + 1];
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::run(unsigned long long cycles) {
+#ifdef CHIP8_PROFILE
+    // Held in locals, as any memory write could otherwise change them as far as the compiler knows.
+    uint64_t *const pcCounts = profiler != nullptr ? profiler->addressCounts() : nullptr;
+    uint64_t *const opCounts = profiler != nullptr ? profiler->opClassCounts() : nullptr;
+#define CHIP8_COUNT(ins)                                   \
+    if (pcCounts != nullptr) {                             \
+        ++pcCounts[pc & ADDRESS_MASK];                     \
+        ++opCounts[static_cast<uint8_t>((ins).op)];        \
+    }
+#define CHIP8_COUNT_WAIT(skipped)                                              \
+    if (profiler != nullptr) {                                                 \
+        profiler->skippedWait(pc, cycleCount - (skipped), skipped);            \
+    }
+#else
+#define CHIP8_COUNT(ins)
+#define CHIP8_COUNT_WAIT(skipped)
+#endif
+
+#if defined(__GNUC__)
+    // Threaded dispatch: every handler ends in its own fetch and indirect jump, so the branch predictor learns
+    // which handler tends to follow which instead of sharing the single jump of a switch. One label per Op, in
+    // enum order.
+    static void *const handlers[] = {
+        &&op_NULL, &&op_00E0, &&op_00EE, &&op_1nnn, &&op_2nnn, &&op_3xnn, &&op_4xnn, &&op_5xy0,
+        &&op_6xnn, &&op_7xnn, &&op_8xy0, &&op_8xy1, &&op_8xy2, &&op_8xy3, &&op_8xy4, &&op_8xy5, &&op_8xy6,
+        &&op_8xy7, &&op_8xyE, &&op_9xy0, &&op_Annn, &&op_Bnnn, &&op_Cxnn, &&op_Dxyn, &&op_Ex9E, &&op_ExA1,
+        &&op_Fx07, &&op_Fx0A, &&op_Fx15, &&op_Fx18, &&op_Fx1E, &&op_Fx29, &&op_Fx33, &&op_Fx55, &&op_Fx65,
+        &&op_00Cn, &&op_00FB, &&op_00FC, &&op_00FD, &&op_00FE, &&op_00FF, &&op_Fx30, &&op_Fx75, &&op_Fx85,
+        &&op_00Dn, &&op_5xy2, &&op_5xy3, &&op_F000, &&op_Fn01, &&op_F002, &&op_Fx3A,
+    };
+    static_assert(std::size(handlers) == static_cast<size_t>(Op::OP_Fx3A) + 1);
+
+    Instruction ins;
+#define CHIP8_DISPATCH()                                        \
+    ins = fetch();                                              \
+    goto *handlers[static_cast<uint8_t>(ins.op)]
+#define CHIP8_NEXT()                                            \
+    ++cycleCount;                                               \
+    if (--cycles == 0) {                                        \
+        return;                                                 \
+    }                                                           \
+    CHIP8_DISPATCH()
+#define CHIP8_OP(name, call)                                    \
+    op_##name:                                                  \
+    CHIP8_COUNT(ins)                                            \
+    pc += 2;                                                    \
+    call;                                                       \
+    CHIP8_NEXT();
+
+    if (cycles == 0) {
+        return;
+    }
+    CHIP8_DISPATCH();
+
+    op_Fx07:
+    if (const unsigned long long skipped = skipDelayWait(ins, cycles); skipped > 0) {
+        CHIP8_COUNT_WAIT(skipped)
+        cycles -= skipped;
+        if (cycles == 0) {
+            return;
+        }
+        CHIP8_DISPATCH();
+    }
+    CHIP8_COUNT(ins)
     pc += 2;
+    OP_Fx07(ins);
+    CHIP8_NEXT();
+
+    CHIP8_OP(NULL, OP_NULL())
+    CHIP8_OP(00E0, OP_00E0())
+    CHIP8_OP(00EE, OP_00EE())
+    CHIP8_OP(1nnn, OP_1nnn(ins))
+    CHIP8_OP(2nnn, OP_2nnn(ins))
+    CHIP8_OP(3xnn, OP_3xnn(ins))
+    CHIP8_OP(4xnn, OP_4xnn(ins))
+    CHIP8_OP(5xy0, OP_5xy0(ins))
+    CHIP8_OP(6xnn, OP_6xnn(ins))
+    CHIP8_OP(7xnn, OP_7xnn(ins))
+    CHIP8_OP(8xy0, OP_8xy0(ins))
+    CHIP8_OP(8xy1, OP_8xy1(ins))
+    CHIP8_OP(8xy2, OP_8xy2(ins))
+    CHIP8_OP(8xy3, OP_8xy3(ins))
+    CHIP8_OP(8xy4, OP_8xy4(ins))
+    CHIP8_OP(8xy5, OP_8xy5(ins))
+    CHIP8_OP(8xy6, OP_8xy6(ins))
+    CHIP8_OP(8xy7, OP_8xy7(ins))
+    CHIP8_OP(8xyE, OP_8xyE(ins))
+    CHIP8_OP(9xy0, OP_9xy0(ins))
+    CHIP8_OP(Annn, OP_Annn(ins))
+    CHIP8_OP(Bnnn, OP_Bnnn(ins))
+    CHIP8_OP(Cxnn, OP_Cxnn(ins))
+    CHIP8_OP(Dxyn, OP_Dxyn(ins))
+    CHIP8_OP(Ex9E, OP_Ex9E(ins))
+    CHIP8_OP(ExA1, OP_ExA1(ins))
+    CHIP8_OP(Fx0A, OP_Fx0A(ins))
+    CHIP8_OP(Fx15, OP_Fx15(ins))
+    CHIP8_OP(Fx18, OP_Fx18(ins))
+    CHIP8_OP(Fx1E, OP_Fx1E(ins))
+    CHIP8_OP(Fx29, OP_Fx29(ins))
+    CHIP8_OP(Fx33, OP_Fx33(ins))
+    CHIP8_OP(Fx55, OP_Fx55(ins))
+    CHIP8_OP(Fx65, OP_Fx65(ins))
+    CHIP8_OP(00Cn, OP_00Cn(ins))
+    CHIP8_OP(00FB, OP_00FB())
+    CHIP8_OP(00FC, OP_00FC())
+    CHIP8_OP(00FD, OP_00FD())
+    CHIP8_OP(00FE, OP_00FE())
+    CHIP8_OP(00FF, OP_00FF())
+    CHIP8_OP(Fx30, OP_Fx30(ins))
+    CHIP8_OP(Fx75, OP_Fx75(ins))
+    CHIP8_OP(Fx85, OP_Fx85(ins))
+    CHIP8_OP(00Dn, OP_00Dn(ins))
+    CHIP8_OP(5xy2, OP_5xy2(ins))
+    CHIP8_OP(5xy3, OP_5xy3(ins))
+    CHIP8_OP(F000, OP_F000())
+    CHIP8_OP(Fn01, OP_Fn01(ins))
+    CHIP8_OP(F002, OP_F002())
+    CHIP8_OP(Fx3A, OP_Fx3A(ins))
+
+#undef CHIP8_OP
+#undef CHIP8_NEXT
+#undef CHIP8_DISPATCH
+#else
+    while (cycles > 0) {
+        // Fetch
+        const Instruction ins = fetch();
+
+        if (ins.op == Op::OP_Fx07) [[unlikely]] {
+            if (const unsigned long long skipped = skipDelayWait(ins, cycles); skipped > 0) {
+                CHIP8_COUNT_WAIT(skipped)
+                cycles -= skipped;
+                continue;
+            }
+        }
+
+        CHIP8_COUNT(ins)
+
+        pc += 2;
+
+        // Decode and Execute
+        execute(ins);
 
-    // Decode and Execute
-    (this->*table[(opcode & 0xF000u) >> 12u]) ();
+        ++cycleCount;
+        --cycles;
+    }
+#endif
+#undef CHIP8_COUNT_WAIT
+#undef CHIP8_COUNT
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::setDelayTimer(const uint8_t value) {
+    delaySet = value;
+    delayFrame = cycleCount / cyclesPerFrame;
+}
 
-    if (soundTimer > 0) --soundTimer;
-    if (delayTimer > 0) --delayTimer;
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::setSoundTimer(const uint8_t value) {
+    soundSet = value;
+    soundFrame = cycleCount / cyclesPerFrame;
+}
+
+template <typename Machine, typename Quirks>
+unsigned long long BasicCPU<Machine, Quirks>::skipDelayWait(const Instruction ins, const unsigned long long budget) {
+    const auto opcodeAt = [this](const unsigned int address) {
+        return static_cast<uint16_t>(memory[address & ADDRESS_MASK] << 8u | memory[(address + 1) & ADDRESS_MASK]);
+    };
+    const uint16_t opcodes[4] = {opcodeAt(pc), opcodeAt(pc + 2), opcodeAt(pc + 4), opcodeAt(pc + 6)};
+    const bool waits = ins.op == Op::OP_Fx07 && isDelayWait(pc, opcodes);
+    if (!waits || delayTimer() == 0) {
+        return 0;
+    }
+
+    // The first cycle at which the delay timer reads 0 ends the wait, rounds before it are skipped whole.
+    const uint64_t expiry = (delayFrame + delaySet) * cyclesPerFrame;
+    const uint64_t rounds = std::min<uint64_t>((expiry - cycleCount + 2) / 3, budget / 3);
+    if (rounds == 0) {
+        return 0;
+    }
+
+    cycleCount += rounds * 3;
+    registers[ins.x] = timerValue(delaySet, delayFrame, cycleCount - 3); // Read by the last skipped Fx07.
+    return rounds * 3;
+}
+
+template <typename Machine, typename Quirks>
+bool BasicCPU<Machine, Quirks>::isDelayWait(const unsigned int address, const uint16_t (&opcodes)[4]) {
+    // Fx07; 3x00; 1nnn back to the Fx07, or Fx07; 4x00; 1nnn out; 1nnn back. Either way a round is three
+    // instructions that change nothing but VX, repeated until VX reads 0. 1nnn only reaches the first 4KB, so
+    // above that the jump goes elsewhere and nothing loops.
+    if (address > 0x0FFFu || (opcodes[0] & 0xF0FFu) != 0xF007u) {
+        return false;
+    }
+    const unsigned int x = opcodes[0] >> 8u & 0xFu;
+    const uint16_t back = 0x1000u | address;
+    return (opcodes[1] == (0x3000u | x << 8u) && opcodes[2] == back) ||
+           (opcodes[1] == (0x4000u | x << 8u) && (opcodes[2] & 0xF000u) == 0x1000u && opcodes[3] == back);
+}
+
+template <typename Machine, typename Quirks>
+inline void BasicCPU<Machine, Quirks>::skip() {
+    if constexpr (Machine::XO) {
+        // F000 nnnn is four bytes long and is skipped whole.
+        if (memory[pc & ADDRESS_MASK] == 0xF0 && memory[(pc + 1) & ADDRESS_MASK] == 0x00) {
+            pc += 4;
+            return;
+        }
+    }
+    pc += 2;
+}
+
+template <typename Machine, typename Quirks>
+inline void BasicCPU<Machine, Quirks>::stepIndex(const unsigned int x) {
+    if constexpr (Quirks::LOAD_STORE == LoadStore::AddX) {
+        index += x;
+    } else if constexpr (Quirks::LOAD_STORE == LoadStore::AddXPlusOne) {
+        index += x + 1;
+    }
+}
+
+// --- Extended Display ---
+
+namespace {
+    // Double every bit of a 16-bit sprite row, giving the 32-bit row a low resolution sprite covers.
+    uint32_t doubleBits(uint32_t bits) {
+        bits = (bits | bits << 8u) & 0x00FF00FFu;
+        bits = (bits | bits << 4u) & 0x0F0F0F0Fu;
+        bits = (bits | bits << 2u) & 0x33333333u;
+        bits = (bits | bits << 1u) & 0x55555555u;
+        return bits | bits << 1u;
+    }
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::drawExtended(const Instruction ins) {
+    // In low resolution every sprite pixel covers 2x2 display pixels. Dxy0 draws a 16x16 sprite, two bytes a row.
+    // With two planes selected the second plane's rows follow the first's.
+    const unsigned int scale = hires ? 1 : 2;
+    const unsigned int width = WIDTH / scale;
+    const unsigned int height = HEIGHT / scale;
+    const unsigned int X = registers[ins.x] % width;
+    const unsigned int Y = registers[ins.y] % height;
+    const bool big = ins.n() == 0;
+    const unsigned int rows = big ? 16 : ins.n();
+
+    bool collision = false;
+    unsigned int address = index;
+
+    for (unsigned int p = 0; p < PLANES; ++p) {
+        if ((planes >> p & 1u) == 0) continue;
+
+        for (unsigned int row = 0; row < rows; ++row) {
+            uint32_t bits = memory[address & ADDRESS_MASK] << 8u;
+            if (big) {
+                bits |= memory[(address + 1) & ADDRESS_MASK];
+            }
+            address += big ? 2 : 1;
+
+            auto y = Y + row;
+            if (y >= height) {
+                if (!Quirks::WRAP_SPRITES) continue;
+                y %= height;
+            }
+
+            bits = scale == 1 ? bits << 16u : doubleBits(bits);
+            for (unsigned int s = 0; s < scale; ++s) {
+                collision |= draw(p, y * scale + s, X * scale, bits);
+            }
+        }
+    }
+
+    registers[0xF] = collision ? 1 : 0;
+}
+
+template <typename Machine, typename Quirks>
+bool BasicCPU<Machine, Quirks>::draw(const unsigned int plane, const unsigned int y, const unsigned int x, const uint32_t bits) {
+    // XOR a left-aligned row of up to 32 pixels in at column x. Pixels past the end of its word spill into the
+    // next one, or wrap to the left edge at the end of the row.
+    uint64_t *line = &video[(plane * HEIGHT + y) * ROW_WORDS];
+    const uint64_t sprite = static_cast<uint64_t>(bits) << 32u;
+    const unsigned int word = x / 64u;
+    const unsigned int shift = x % 64u;
+
+    uint64_t collision = line[word] & sprite >> shift;
+    line[word] ^= sprite >> shift;
+
+    if (shift > 32u && (word + 1 < ROW_WORDS || Quirks::WRAP_SPRITES)) {
+        uint64_t &spill = line[(word + 1) % ROW_WORDS];
+        const uint64_t mask = sprite << (64u - shift);
+        collision |= spill & mask;
+        spill ^= mask;
+    }
+
+    dirtyRows |= (bits != 0 ? RowMask{1} : RowMask{0}) << y;
+    return collision != 0;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::scrollVertical(const int rows) {
+    // Whole rows move with one memmove per plane, rows scrolled in are blank. Positive is down.
+    const unsigned int count = std::min<unsigned int>(static_cast<unsigned int>(rows < 0 ? -rows : rows), HEIGHT);
+    const size_t kept = (HEIGHT - count) * ROW_WORDS * sizeof(uint64_t);
+    const size_t cleared = count * ROW_WORDS * sizeof(uint64_t);
+
+    for (unsigned int p = 0; p < PLANES; ++p) {
+        if ((planes >> p & 1u) == 0) continue;
+
+        uint64_t *plane = &video[p * HEIGHT * ROW_WORDS];
+        if (rows > 0) {
+            memmove(plane + count * ROW_WORDS, plane, kept);
+            memset(plane, 0, cleared);
+        } else {
+            memmove(plane, plane + count * ROW_WORDS, kept);
+            memset(plane + (HEIGHT - count) * ROW_WORDS, 0, cleared);
+        }
+    }
+    dirtyRows = ALL_ROWS;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::scrollHorizontal(const int columns) {
+    // Each row is shifted as a multi-word integer, columns scrolled in are blank. Positive is right, under 64.
+    const unsigned int n = static_cast<unsigned int>(columns < 0 ? -columns : columns);
+
+    for (unsigned int p = 0; p < PLANES; ++p) {
+        if ((planes >> p & 1u) == 0) continue;
+
+        for (unsigned int y = 0; y < HEIGHT; ++y) {
+            uint64_t *line = &video[(p * HEIGHT + y) * ROW_WORDS];
+            if (columns > 0) {
+                for (unsigned int w = ROW_WORDS - 1; w > 0; --w) {
+                    line[w] = line[w] >> n | line[w - 1] << (64u - n);
+                }
+                line[0] >>= n;
+            } else {
+                for (unsigned int w = 0; w + 1 < ROW_WORDS; ++w) {
+                    line[w] = line[w] << n | line[w + 1] >> (64u - n);
+                }
+                line[ROW_WORDS - 1] <<= n;
+            }
+        }
+    }
+    dirtyRows = ALL_ROWS;
 }
 
 // --- CPU Instructional Functions ---
 
-void vCPU::OP_NULL() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_NULL() {
     // Do nothing.
 }
 
-void vCPU::OP_00E0() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00E0() {
     // Clear the display.
-    memset(video, 0, sizeof(video));
+    if constexpr (PLANES == 1) {
+        memset(video, 0, sizeof(video));
+    } else {
+        for (unsigned int p = 0; p < PLANES; ++p) {
+            if (planes >> p & 1u) {
+                memset(&video[p * HEIGHT * ROW_WORDS], 0, sizeof(video) / PLANES);
+            }
+        }
+    }
+    dirtyRows = ALL_ROWS;
 }
 
-void vCPU::OP_00EE() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00EE() {
     // Return from a subroutine.
     --sp;
-    pc = stack[sp];
+    pc = stack[sp & 0xFu];
 }
 
-void vCPU::OP_1nnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_1nnn(const Instruction ins) {
     // Jump to address nnn.
-    pc = opcode & 0x0FFFu;
+    pc = ins.nnn();
 }
 
-void vCPU::OP_2nnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_2nnn(const Instruction ins) {
     // Execute subroutine starting at nnn.
-    stack[sp] = pc;
+    stack[sp & 0xFu] = pc;
     ++sp;
-    pc = opcode & 0x0FFFu;
+    pc = ins.nnn();
 }
 
-void vCPU::OP_3xnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_3xnn(const Instruction ins) {
     // Skip next instruction if value of register VX == nn.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto nn = opcode & 0x00FFu;
+    const auto X = ins.x;
+    const auto nn = ins.nn;
 
     if (registers[X] == nn) {
-        pc += 2;
+        skip();
     }
 }
 
-void vCPU::OP_4xnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_4xnn(const Instruction ins) {
     // Skip next instruction if value of register VX != nn.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto nn = opcode & 0x00FFu;
+    const auto X = ins.x;
+    const auto nn = ins.nn;
 
     if (registers[X] != nn) {
-        pc += 2;
+        skip();
     }
 }
 
-void vCPU::OP_5xy0() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_5xy0(const Instruction ins) {
     // Skip next instruction if value of register VX == value of register VY.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     if (registers[X] == registers[Y]) {
-        pc += 2;
+        skip();
     }
 }
 
-void vCPU::OP_6xnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_6xnn(const Instruction ins) {
     // Set value of register VX to nn.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto nn = opcode & 0x00FFu;
+    const auto X = ins.x;
+    const auto nn = ins.nn;
 
     registers[X] = nn;
 }
 
-void vCPU::OP_7xnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_7xnn(const Instruction ins) {
     // Add nn to value of register VX.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto nn = opcode & 0x00FFu;
+    const auto X = ins.x;
+    const auto nn = ins.nn;
 
     registers[X] += nn;
 }
 
-void vCPU::OP_8xy0() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy0(const Instruction ins) {
     // Set value of register VX to value of register VY.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     registers[X] = registers[Y];
 }
 
-void vCPU::OP_8xy1() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy1(const Instruction ins) {
     // Set value of register VX to (value of register VX OR value of register VY).
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     registers[X] |= registers[Y];
+
+    if constexpr (Quirks::LOGIC_RESETS_VF) {
+        registers[0xF] = 0;
+    }
 }
 
-void vCPU::OP_8xy2() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy2(const Instruction ins) {
     // Set value of register VX to (value of register VX AND value of register VY).
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     registers[X] &= registers[Y];
+
+    if constexpr (Quirks::LOGIC_RESETS_VF) {
+        registers[0xF] = 0;
+    }
 }
 
-void vCPU::OP_8xy3() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy3(const Instruction ins) {
     // Set value of register VX to (value of register VX XOR value of register VY).
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     registers[X] ^= registers[Y];
+
+    if constexpr (Quirks::LOGIC_RESETS_VF) {
+        registers[0xF] = 0;
+    }
 }
 
-void vCPU::OP_8xy4() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy4(const Instruction ins) {
     // Add value of register VY to register VX. Set VF to 1 if there is a carry, 0 if not.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     const auto sum = registers[X] + registers[Y];
 
-    registers[0xF] = sum > 255U ? 1 : 0;
+    // VF last, so the flag wins when X is F.
     registers[X] = sum;
+    registers[0xF] = sum > 255U ? 1 : 0;
 }
 
-void vCPU::OP_8xy5() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy5(const Instruction ins) {
     // Subtract value of register VY from register VX. Set VF to 0 if there is a borrow, 1 if not.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
-    registers[0xF] = registers[X] > registers[Y] ? 1 : 0;
+    const uint8_t noBorrow = registers[X] >= registers[Y] ? 1 : 0;
     registers[X] -= registers[Y];
+    registers[0xF] = noBorrow;
 }
 
-void vCPU::OP_8xy6() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy6(const Instruction ins) {
     // Store the least significant bit of register VX in register VF, then shift VX to the right by 1.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
+
+    if constexpr (Quirks::SHIFT_VY) {
+        registers[X] = registers[ins.y]; // VX = VY >> 1, VF from VY.
+    }
 
-    registers[0xF] = registers[X] & 0x1u;
+    const uint8_t shiftedOut = registers[X] & 0x1u;
     registers[X] >>= 1;
+    registers[0xF] = shiftedOut;
 }
 
-void vCPU::OP_8xy7() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xy7(const Instruction ins) {
     // Set register VX to value of register VY minus register VX. Set VF to 0 if there is a borrow, 1 if not.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
-    registers[0xF] = registers[Y] > registers[X] ? 1 : 0;
+    const uint8_t noBorrow = registers[Y] >= registers[X] ? 1 : 0;
     registers[X] = registers[Y] - registers[X];
+    registers[0xF] = noBorrow;
 }
 
-void vCPU::OP_8xyE() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_8xyE(const Instruction ins) {
     // Store the most significant bit of register VX in register VF, then shift VX to the left by 1.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
-    registers[0xF] = (registers[X] & 0x80u) >> 7u;
+    if constexpr (Quirks::SHIFT_VY) {
+        registers[X] = registers[ins.y]; // VX = VY << 1, VF from VY.
+    }
+
+    const uint8_t shiftedOut = (registers[X] & 0x80u) >> 7u;
     registers[X] <<= 1;
+    registers[0xF] = shiftedOut;
 }
 
-void vCPU::OP_9xy0() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_9xy0(const Instruction ins) {
     // Skip next instruction if (value of register VX != value of register VY).
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto Y = (opcode & 0x00F0u) >> 4u;
+    const auto X = ins.x;
+    const auto Y = ins.y;
 
     if (registers[X] != registers[Y]) {
-        pc += 2;
+        skip();
     }
 }
 
-void vCPU::OP_Annn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Annn(const Instruction ins) {
     // Set index to address nnn.
-    index = opcode & 0x0FFFu;
+    index = ins.nnn();
 }
 
-void vCPU::OP_Bnnn() {
-    // Jump to address (nnn + value of register V0).
-    pc = (opcode & 0x0FFFu) + registers[0];
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Bnnn(const Instruction ins) {
+    // Jump to address (nnn + value of register V0), or (xnn + value of register VX) with Bxnn.
+    if constexpr (Quirks::JUMP_VX) {
+        pc = ins.nnn() + registers[ins.x];
+    } else {
+        pc = (ins.nnn()) + registers[0];
+    }
 }
 
-void vCPU::OP_Cxnn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Cxnn(const Instruction ins) {
     // Set register VX to a random number with mask of nn.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    const auto nn = opcode & 0x00FFu;
+    const auto X = ins.x;
+    const auto nn = ins.nn;
 
-    registers[X] = rand() & nn;
+    registers[X] = randomByte() & nn;
 }
 
-void vCPU::OP_Dxyn() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Dxyn(const Instruction ins) {
     // Draw a sprite at position VX, VY with n bytes of sprite data starting at the address stored in index register.
-    const auto X = registers[(opcode & 0x0F00u) >> 8u];
-    const auto Y = registers[(opcode & 0x00F0u) >> 4u];
-    const auto height = opcode & 0x000Fu;
+#ifdef CHIP8_PROFILE
+    if (profiler != nullptr) {
+        profiler->draw(cycleCount, Machine::SUPER && ins.n() == 0 ? 16 : ins.n());
+    }
+#endif
 
-    registers[0xF] = 0;
+    if constexpr (Machine::SUPER) {
+        drawExtended(ins);
+        return;
+    }
 
-    for (unsigned int row = 0; row < height; ++row) {
-        const auto sprite = memory[index + row];
+    const auto X = registers[ins.x] % 64u;
+    const auto Y = registers[ins.y] % 32u;
+    const auto height = ins.n();
 
-        for (unsigned int col = 0; col < 8; ++col) {
-            const auto pixel = sprite & (0x80u >> col);
-            auto *screenPixel = &video[(Y + row) * 64 + (X + col)];
+    uint64_t collision = 0;
 
-            if (pixel) {
-                if (*screenPixel == 1) {
-                    registers[0xF] = 1;
-                }
+    for (unsigned int row = 0; row < height; ++row) {
+        auto y = Y + row;
+        if (y >= 32) {
+            if (!Quirks::WRAP_SPRITES) break;
+            y %= 32;
+        }
 
-                *screenPixel ^= 1;
-            }
+        // Each sprite row is one shifted (or rotated) word XORed into the display row.
+        const uint64_t sprite = static_cast<uint64_t>(memory[(index + row) & ADDRESS_MASK]) << 56u;
+        uint64_t mask;
+        if constexpr (Quirks::WRAP_SPRITES) {
+            mask = std::rotr(sprite, static_cast<int>(X));
+        } else {
+            mask = sprite >> X;
         }
+
+        collision |= video[y] & mask;
+        video[y] ^= mask;
+        dirtyRows |= (mask != 0 ? 1u : 0u) << y;
     }
+
+    registers[0xF] = collision != 0 ? 1 : 0;
 }
 
-void vCPU::OP_Ex9E() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Ex9E(const Instruction ins) {
     // Skip next instruction if key with the value of register VX is pressed.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
-    if (keypad[registers[X]] != 0) {
-        pc += 2;
+    if (keypad[registers[X] & 0xFu] != 0) {
+        skip();
     }
 }
 
-void vCPU::OP_ExA1() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_ExA1(const Instruction ins) {
     // Skip next instruction if key with the value of register VX is not pressed.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
-    if (keypad[registers[X]] == 0) {
-        pc += 2;
+    if (keypad[registers[X] & 0xFu] == 0) {
+        skip();
     }
 }
 
-void vCPU::OP_Fx07() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx07(const Instruction ins) {
     // Set register VX to the value of the delay timer.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
-    registers[X] = delayTimer;
+    registers[X] = delayTimer();
 }
 
-void vCPU::OP_Fx0A() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx0A(const Instruction ins) {
     // Wait for a key press, store the value of the key in VX.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
     for (unsigned int i = 0; i < 16; ++i) {
         if (keypad[i] != 0) {
@@ -371,59 +1063,212 @@ void vCPU::OP_Fx0A() {
     pc -= 2;
 }
 
-void vCPU::OP_Fx15() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx15(const Instruction ins) {
     // Set the delay timer to the value of register VX.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
-    delayTimer = registers[X];
+    setDelayTimer(registers[X]);
 }
 
-void vCPU::OP_Fx18() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx18(const Instruction ins) {
     // Set the sound timer to the value of register VX.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
-    soundTimer = registers[X];
+    setSoundTimer(registers[X]);
 }
 
-void vCPU::OP_Fx1E() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx1E(const Instruction ins) {
     // Add the value of register VX to index.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
     index += registers[X];
 }
 
-void vCPU::OP_Fx29() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx29(const Instruction ins) {
     // Set index to the location of the sprite for the character in register VX.
-    const auto X = (opcode & 0x0F00u) >> 8u;
-    index = registers[X] * 5;
+    const auto X = ins.x;
+    index = 0x50 + (registers[X] & 0xFu) * 5; // The font is stored from 0x50.
 }
 
-void vCPU::OP_Fx33() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx33(const Instruction ins) {
     // Store the binary-coded decimal representation of the value of register VX at the addresses index, index+1, and index+2.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
     const auto value = registers[X];
 
-    memory[index] = value / 100;
-    memory[index + 1] = (value / 10) % 10;
-    memory[index + 2] = value % 10;
+    memory[index & ADDRESS_MASK] = value / 100;
+    memory[(index + 1) & ADDRESS_MASK] = (value / 10) % 10;
+    memory[(index + 2) & ADDRESS_MASK] = value % 10;
+
+    invalidate(index, 3);
 }
 
-void vCPU::OP_Fx55() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx55(const Instruction ins) {
     // Store the values of registers V0 to VX inclusive in memory starting at the address in index register.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
 
     for (unsigned int i = 0; i <= X; ++i) {
-        memory[index + i] = registers[i];
+        memory[(index + i) & ADDRESS_MASK] = registers[i];
     }
+
+    invalidate(index, X + 1);
+    stepIndex(X);
 }
 
-void vCPU::OP_Fx65() {
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx65(const Instruction ins) {
     // Fill registers V0 to VX inclusive with the values stored in memory starting at the address in index register.
-    const auto X = (opcode & 0x0F00u) >> 8u;
+    const auto X = ins.x;
+
+    for (unsigned int i = 0; i <= X; ++i) {
+        registers[i] = memory[(index + i) & ADDRESS_MASK];
+    }
+
+    stepIndex(X);
+}
+
+// --- SUPER-CHIP Instructions ---
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00Cn(const Instruction ins) {
+    // Scroll the display down n rows, twice that in low resolution.
+    scrollVertical(static_cast<int>(ins.n() * (hires ? 1 : 2)));
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00FB() {
+    // Scroll the display right 4 columns, 8 in low resolution.
+    scrollHorizontal(hires ? 4 : 8);
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00FC() {
+    // Scroll the display left 4 columns, 8 in low resolution.
+    scrollHorizontal(hires ? -4 : -8);
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00FD() {
+    // Exit the interpreter. There is nothing to return to, so pc stays on this instruction.
+    pc -= 2;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00FE() {
+    // Switch to 64x32 low resolution and clear the display.
+    hires = false;
+    memset(video, 0, sizeof(video));
+    dirtyRows = ALL_ROWS;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00FF() {
+    // Switch to 128x64 high resolution and clear the display.
+    hires = true;
+    memset(video, 0, sizeof(video));
+    dirtyRows = ALL_ROWS;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx30(const Instruction ins) {
+    // Set index to the location of the 8x10 sprite for the digit in register VX.
+    const auto X = ins.x;
+    index = 0xA0 + (registers[X] & 0xFu) * 10;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx75(const Instruction ins) {
+    // Store the values of registers V0 to VX inclusive in the flag registers.
+    const auto X = ins.x;
+
+    for (unsigned int i = 0; i <= X; ++i) {
+        flags[i] = registers[i];
+    }
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx85(const Instruction ins) {
+    // Fill registers V0 to VX inclusive with the values of the flag registers.
+    const auto X = ins.x;
 
     for (unsigned int i = 0; i <= X; ++i) {
-        registers[i] = memory[index + i];
+        registers[i] = flags[i];
+    }
+}
+
+// --- XO-CHIP Instructions ---
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_00Dn(const Instruction ins) {
+    // Scroll the display up n rows, twice that in low resolution.
+    scrollVertical(-static_cast<int>(ins.n() * (hires ? 1 : 2)));
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_5xy2(const Instruction ins) {
+    // Store the values of registers VX to VY inclusive in memory starting at the address in index register.
+    // Registers go in descending order when X > Y. Index is left unchanged.
+    const auto X = ins.x;
+    const auto Y = ins.y;
+    const unsigned int count = (X <= Y ? Y - X : X - Y) + 1;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        memory[(index + i) & ADDRESS_MASK] = registers[X <= Y ? X + i : X - i];
     }
+
+    invalidate(index, count);
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_5xy3(const Instruction ins) {
+    // Fill registers VX to VY inclusive with the values stored in memory starting at the address in index register.
+    const auto X = ins.x;
+    const auto Y = ins.y;
+    const unsigned int count = (X <= Y ? Y - X : X - Y) + 1;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        registers[X <= Y ? X + i : X - i] = memory[(index + i) & ADDRESS_MASK];
+    }
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_F000() {
+    // Set index to the 16-bit address in the next two bytes, then step over them.
+    index = static_cast<uint16_t>(memory[pc & ADDRESS_MASK] << 8u | memory[(pc + 1) & ADDRESS_MASK]);
+    pc += 2;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fn01(const Instruction ins) {
+    // Select the planes in bit mask n for drawing, scrolling and clearing.
+    planes = ins.x & ((1u << PLANES) - 1);
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_F002() {
+    // Load the 16-byte audio pattern from memory starting at the address in index register.
+    for (unsigned int i = 0; i < 16; ++i) {
+        audioPattern[i] = memory[(index + i) & ADDRESS_MASK];
+    }
+    customAudio = true;
+}
+
+template <typename Machine, typename Quirks>
+void BasicCPU<Machine, Quirks>::OP_Fx3A(const Instruction ins) {
+    // Set the audio pattern pitch to the value of register VX.
+    const auto X = ins.x;
+    pitch = registers[X];
 }
 
 // --- END ---
+
+template class BasicCPU<Chip8>;
+template class BasicCPU<Chip8, VipQuirks>;
+template class BasicCPU<Chip8, Chip48Quirks>;
+template class BasicCPU<SuperChip>;
+template class BasicCPU<XoChip>;
@@ -1,75 +1,340 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <random>
+#include <type_traits>
+
+struct SaveState;
+#ifdef CHIP8_PROFILE
+class Profiler;
+#endif
+
+// Quirk policies, the behaviours interpreters disagree on. Each is a template argument of BasicCPU, so a handler
+// compiles to the one behaviour its policy picks with no flag to test.
+enum class LoadStore : uint8_t {
+    Unchanged, // Fx55/Fx65 leave index alone.
+    AddX, // Index ends at index + X.
+    AddXPlusOne // Index ends after the last register stored or loaded.
+};
+
+// What most current interpreters do, and what the vCPU has always done.
+struct ModernQuirks {
+    static constexpr bool SHIFT_VY = false; // 8xy6/8xyE shift VY into VX instead of shifting VX in place.
+    static constexpr LoadStore LOAD_STORE = LoadStore::Unchanged;
+    static constexpr bool JUMP_VX = false; // Bnnn is Bxnn, jumping to xnn + VX instead of nnn + V0.
+    static constexpr bool LOGIC_RESETS_VF = false; // 8xy1/8xy2/8xy3 clear VF.
+    static constexpr bool WRAP_SPRITES = false; // Dxyn wraps sprites around the screen edges instead of clipping.
+};
+
+// The original COSMAC VIP interpreter.
+struct VipQuirks {
+    static constexpr bool SHIFT_VY = true;
+    static constexpr LoadStore LOAD_STORE = LoadStore::AddXPlusOne;
+    static constexpr bool JUMP_VX = false;
+    static constexpr bool LOGIC_RESETS_VF = true;
+    static constexpr bool WRAP_SPRITES = false;
+};
+
+// CHIP-48 on the HP-48.
+struct Chip48Quirks {
+    static constexpr bool SHIFT_VY = false;
+    static constexpr LoadStore LOAD_STORE = LoadStore::AddX;
+    static constexpr bool JUMP_VX = true;
+    static constexpr bool LOGIC_RESETS_VF = false;
+    static constexpr bool WRAP_SPRITES = false;
+};
+
+// SUPER-CHIP 1.1.
+struct SuperChipQuirks {
+    static constexpr bool SHIFT_VY = false;
+    static constexpr LoadStore LOAD_STORE = LoadStore::Unchanged;
+    static constexpr bool JUMP_VX = true;
+    static constexpr bool LOGIC_RESETS_VF = false;
+    static constexpr bool WRAP_SPRITES = false;
+};
+
+// XO-CHIP as Octo runs it.
+struct XoChipQuirks {
+    static constexpr bool SHIFT_VY = true;
+    static constexpr LoadStore LOAD_STORE = LoadStore::AddXPlusOne;
+    static constexpr bool JUMP_VX = false;
+    static constexpr bool LOGIC_RESETS_VF = false;
+    static constexpr bool WRAP_SPRITES = true;
+};
+
+// Machine profiles. Each is a separate BasicCPU instantiation, so instructions a profile lacks are never decoded
+// and plain CHIP-8 runs exactly the code it always did.
+struct Chip8 {
+    static constexpr unsigned int MEMORY = 4096;
+    static constexpr unsigned int WIDTH = 64;
+    static constexpr unsigned int HEIGHT = 32;
+    static constexpr unsigned int PLANES = 1;
+    static constexpr bool SUPER = false; // SUPER-CHIP: hi-res mode, scrolling, 16x16 sprites, big font, flags.
+    static constexpr bool XO = false; // XO-CHIP: 64KB memory, two bit planes, long index loads, audio pattern.
+    using DefaultQuirks = ModernQuirks;
+};
+
+struct SuperChip {
+    static constexpr unsigned int MEMORY = 4096;
+    static constexpr unsigned int WIDTH = 128;
+    static constexpr unsigned int HEIGHT = 64;
+    static constexpr unsigned int PLANES = 1;
+    static constexpr bool SUPER = true;
+    static constexpr bool XO = false;
+    using DefaultQuirks = SuperChipQuirks;
+};
+
+struct XoChip {
+    static constexpr unsigned int MEMORY = 65536;
+    static constexpr unsigned int WIDTH = 128;
+    static constexpr unsigned int HEIGHT = 64;
+    static constexpr unsigned int PLANES = 2;
+    static constexpr bool SUPER = true;
+    static constexpr bool XO = true;
+    using DefaultQuirks = XoChipQuirks;
+};
 
 // ReSharper disable CppMemberFunctionMayBeStatic
-class vCPU {
+// Cache-line aligned so instances stored side by side never share a line between threads.
+template <typename Machine, typename Quirks = typename Machine::DefaultQuirks>
+class alignas(64) BasicCPU {
 public:
-    const unsigned int START_ADDRESS = 0x200;
+    static constexpr unsigned int START_ADDRESS = 0x200;
     // Program counter starts at 0x200, as the first 512 bytes are reserved for the interpreter.
 
-    vCPU();
+    static constexpr unsigned int MEMORY = Machine::MEMORY;
+    static constexpr unsigned int ADDRESS_MASK = MEMORY - 1;
+    static constexpr unsigned int WIDTH = Machine::WIDTH;
+    static constexpr unsigned int HEIGHT = Machine::HEIGHT;
+    static constexpr unsigned int PLANES = Machine::PLANES;
+    static constexpr unsigned int ROW_WORDS = WIDTH / 64; // 64-bit words per display row.
+
+    // One bit per display row.
+    using RowMask = std::conditional_t<(HEIGHT > 32), uint64_t, uint32_t>;
+    static constexpr RowMask ALL_ROWS = static_cast<RowMask>(~RowMask{0});
+
+    BasicCPU(); // Random generator seeded from the clock.
+    explicit BasicCPU(uint64_t seed);
 
-    void loadROM(const char *filename);
+    void seed(uint64_t seed); // Restart the random generator, the same seed gives the same Cxnn results.
+
+    // Copy a ROM into memory at START_ADDRESS. False if the file cannot be read, or the ROM is empty or does not
+    // fit, which is checked before memory is touched.
+    bool loadROM(const char *filename);
+    bool loadROM(const uint8_t *data, size_t size);
     void cycle();
+    void run(unsigned long long cycles); // Execute a number of cycles back to back.
+
+    // Note a memory range written from outside the vCPU, so a BlockEngine drops code compiled from it.
+    void invalidate(uint16_t address, unsigned int length);
+
+    // Restore a boot image, typically a vCPU saved right after loadROM(), in one copy. A BlockEngine running this
+    // vCPU needs flush() afterwards, as after loading a ROM.
+    void reset(const BasicCPU &boot) { *this = boot; }
 
-    uint8_t memory[4096]{}; // 4096 8-bit Memory (4KB).
+    // Copy of a running instance that carries on independently. It shares the random sequence until seed().
+    [[nodiscard]] BasicCPU fork() const { return *this; }
+
+    // Copy the whole machine state into a snapshot, or restore it from one. loadState() returns false and leaves
+    // the vCPU untouched if the snapshot has the wrong magic, version or size. Plain CHIP-8 only.
+    void saveState(SaveState &state) const requires std::is_same_v<Machine, Chip8>;
+    bool loadState(const SaveState &state) requires std::is_same_v<Machine, Chip8>;
+
+    uint8_t memory[MEMORY]{}; // 8-bit Memory, 4KB (64KB on XO-CHIP).
     uint8_t registers[16]{}; // 16 8-bit Registers.
     uint16_t index = 0; // 1 16-bit Register.
     uint16_t pc = START_ADDRESS; // 1 16-bit Program Counter.
     uint16_t stack[16]{}; // 16 16-bit Call Stack.
     uint8_t sp = 0; // 1 8-bit Stack Pointer.
-    uint8_t delayTimer = 0; // 1 8-bit Delay Timer.
-    uint8_t soundTimer = 0; // 1 8-bit Sound Timer.
     uint8_t keypad[16]{}; // 16 8-bit Keypad.
-    uint8_t video[64 * 32]{}; // 64x32 8-bit Video Memory.
-    uint16_t opcode = 0; // 1 16-bit Opcode.
+    uint64_t cycleCount = 0; // Instructions executed since power-on.
+
+    // Instructions per 60Hz frame. The timers tick once each time cycleCount reaches a multiple of this, so they
+    // follow emulated time whatever the instruction rate. 10 gives the usual 600Hz. Must not be 0, and should only
+    // change while both timers are 0.
+    unsigned int cyclesPerFrame = 10;
+
+    // Delay and sound timers, worked out from cycleCount when read.
+    [[nodiscard]] uint8_t delayTimer() const { return timerValue(delaySet, delayFrame, cycleCount); }
+    [[nodiscard]] uint8_t soundTimer() const { return timerValue(soundSet, soundFrame, cycleCount); }
+    void setDelayTimer(uint8_t value);
+    void setSoundTimer(uint8_t value);
+
+    // WIDTHxHEIGHT 1-bit Video Memory per plane, ROW_WORDS words per row with x = 0 in the most significant bit of
+    // the first. Planes follow each other, so plain CHIP-8 has one word per row.
+    uint64_t video[PLANES * HEIGHT * ROW_WORDS]{};
+
+    RowMask dirtyRows = ALL_ROWS; // Display rows changed since a renderer last cleared this, one bit per row.
+
+    // SUPER-CHIP and XO-CHIP state, unused on plain CHIP-8.
+    bool hires = false; // 128x64 mode, otherwise every pixel is drawn 2x2.
+    uint8_t planes = 1; // Planes drawn, scrolled and cleared, set by Fn01.
+    uint8_t flags[16]{}; // Flag registers saved by Fx75, kept across ROMs by real hardware.
+    uint8_t audioPattern[16]{}; // 128-bit 1-bit sample loop loaded by F002.
+    uint8_t pitch = 64; // Playback rate of audioPattern, set by Fx3A.
+    bool customAudio = false; // F002 has run, so the pattern replaces the plain beep.
+
+    // Bit p set when the pixel is lit on plane p.
+    [[nodiscard]] uint8_t pixel(const unsigned int x, const unsigned int y) const {
+        uint8_t bits = 0;
+        for (unsigned int p = 0; p < PLANES; ++p) {
+            bits |= (video[(p * HEIGHT + y) * ROW_WORDS + x / 64u] >> (63u - x % 64u) & 1u) << p;
+        }
+        return bits;
+    }
+
+    // Expand the display into one value per pixel, row by row, a pixel lit on any plane becomes on.
+    void expandVideo(uint32_t *pixels, uint32_t on, uint32_t off) const;
+
+#ifdef CHIP8_PROFILE
+    Profiler *profiler = nullptr; // When set, run() reports every instruction and draw to it.
+#endif
 
 private:
-    std::default_random_engine randGen;
-    std::uniform_int_distribution<uint8_t> randByte;
+    friend class Analyzer;
+    friend class BlockEngine;
+    friend class LockstepBatch;
+#ifdef CHIP8_PROFILE
+    friend class Profiler;
+#endif
+
+    uint64_t randState = 1; // xorshift64* state, never 0.
+
+    uint8_t randomByte();
+
+    // Timers are kept as the value last written and the 60Hz frame it was written in, nothing runs per cycle.
+    uint8_t delaySet = 0;
+    uint8_t soundSet = 0;
+    uint64_t delayFrame = 0;
+    uint64_t soundFrame = 0;
+
+    [[nodiscard]] uint8_t timerValue(const uint8_t set, const uint64_t since, const uint64_t cycles) const {
+        const uint64_t elapsed = cycles / cyclesPerFrame - since;
+        return elapsed < set ? static_cast<uint8_t>(set - elapsed) : 0;
+    }
+
+    // Handler index of a decoded instruction. BlockEnd is no opcode, BlockEngine ends every block with a step of it.
+    enum class Op : uint8_t {
+        OP_NULL, OP_00E0, OP_00EE, OP_1nnn, OP_2nnn, OP_3xnn, OP_4xnn, OP_5xy0, OP_6xnn, OP_7xnn,
+        OP_8xy0, OP_8xy1, OP_8xy2, OP_8xy3, OP_8xy4, OP_8xy5, OP_8xy6, OP_8xy7, OP_8xyE, OP_9xy0,
+        OP_Annn, OP_Bnnn, OP_Cxnn, OP_Dxyn, OP_Ex9E, OP_ExA1, OP_Fx07, OP_Fx0A, OP_Fx15, OP_Fx18,
+        OP_Fx1E, OP_Fx29, OP_Fx33, OP_Fx55, OP_Fx65,
+        // SUPER-CHIP
+        OP_00Cn, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF, OP_Fx30, OP_Fx75, OP_Fx85,
+        // XO-CHIP
+        OP_00Dn, OP_5xy2, OP_5xy3, OP_F000, OP_Fn01, OP_F002, OP_Fx3A,
+        BlockEnd
+    };
+
+    // Instruction with its operands pre-split, nnn is (x << 8 | nn) and n is (nn & 0xF).
+    struct Instruction {
+        Op op = Op::OP_NULL;
+        uint8_t x = 0;
+        uint8_t y = 0;
+        uint8_t nn = 0;
 
-    typedef void (vCPU::*opFunc)();
-    opFunc table[0xF + 1]{};
-    opFunc table0[0xE + 1]{};
-    opFunc table8[0xE + 1]{};
-    opFunc tableE[0xE + 1]{};
-    opFunc tableF[0x65 + 1]{};
+        [[nodiscard]] uint16_t nnn() const { return static_cast<uint16_t>(x << 8u | nn); }
+        [[nodiscard]] uint8_t n() const { return nn & 0xFu; }
+    };
+
+    static Instruction decode(uint16_t opcode);
+
+    Instruction fetch(); // Fetch the instruction at pc, its handler from HANDLERS.
+    void execute(Instruction ins);
+
+    // If the Fx07 at pc starts a busy-wait on the delay timer, jump over whole rounds of it within budget.
+    // Returns the cycles skipped, 0 when there is nothing to skip.
+    unsigned long long skipDelayWait(Instruction ins, unsigned long long budget);
+
+    // True if the opcodes at address, address+2, +4 and +6 are such a busy-wait. The analyzer uses it too, so it
+    // reports exactly the waits run() skips.
+    static bool isDelayWait(unsigned int address, const uint16_t (&opcodes)[4]);
+
+    void skip(); // Step pc over the next instruction.
+    void stepIndex(unsigned int x); // Move index on after Fx55/Fx65 as the LOAD_STORE quirk says.
+
+    // SUPER-CHIP and XO-CHIP display: Dxyn in either resolution, one sprite row XORed into a plane returning
+    // whether it erased a pixel, and scrolls of the selected planes.
+    void drawExtended(Instruction ins);
+    bool draw(unsigned int plane, unsigned int y, unsigned int x, uint32_t bits);
+    void scrollVertical(int rows);
+    void scrollHorizontal(int columns);
+
+    // Handler of every opcode, worked out once and shared by all instances of the profile. Operands are split off
+    // the opcode on fetch, so there is no per-address decode cache: copies stay small and a memory write leaves
+    // nothing to drop.
+    static const std::array<Op, 0x10000> HANDLERS;
+
+    // Memory range written since the BlockEngine last looked, as [writtenBegin, writtenEnd).
+    uint32_t writtenBegin = 0xFFFF;
+    uint32_t writtenEnd = 0;
 
     void OP_NULL(); // Do nothing.
     void OP_00E0(); // Clear the display.
     void OP_00EE(); // Return from a subroutine.
-    void OP_1nnn(); // Jump to address nnn.
-    void OP_2nnn(); // Execute subroutine starting at nnn.
-    void OP_3xnn(); // Skip next instruction if value of register VX == nn.
-    void OP_4xnn(); // Skip next instruction if value of register VX != nn.
-    void OP_5xy0(); // Skip next instruction if value of register VX == value of register VY.
-    void OP_6xnn(); // Set value of register VX to nn.
-    void OP_7xnn(); // Add nn to value of register VX.
-    void OP_8xy0(); // Set value of register VX to value of register VY.
-    void OP_8xy1(); // Set value of register VX to (value of register VX OR value of register VY).
-    void OP_8xy2(); // Set value of register VX to (value of register VX AND value of register VY).
-    void OP_8xy3(); // Set value of register VX to (value of register VX XOR value of register VY).
-    void OP_8xy4(); // Add value of register VY to register VX. Set VF to 1 if there is a carry, 0 if not.
-    void OP_8xy5(); // Subtract value of register VY from register VX. Set VF to 0 if there is a borrow, 1 if not.
-    void OP_8xy6(); // Store the least significant bit of register VX in register VF, then shift VX to the right by 1.
-    void OP_8xy7(); // Set register VX to value of register VY minus register VX. Set VF to 0 if there is a borrow, 1 if not.
-    void OP_8xyE(); // Store the most significant bit of register VX in register VF, then shift VX to the left by 1.
-    void OP_9xy0(); // Skip next instruction if (value of register VX != value of register VY).
-    void OP_Annn(); // Set index to address nnn.
-    void OP_Bnnn(); // Jump to address (nnn + value of register V0).
-    void OP_Cxnn(); // Set register VX to a random number with mask of nn.
-    void OP_Dxyn(); // Draw a sprite at position VX, VY with n bytes of sprite data starting at the address stored in index register.
-    void OP_Ex9E(); // Skip next instruction if key with the value of register VX is pressed.
-    void OP_ExA1(); // Skip next instruction if key with the value of register VX is not pressed.
-    void OP_Fx07(); // Set register VX to the value of the delay timer.
-    void OP_Fx0A(); // Wait for a key press, store the value of the key in register VX.
-    void OP_Fx15(); // Set the delay timer to the value of register VX.
-    void OP_Fx18(); // Set the sound timer to the value of register VX.
-    void OP_Fx1E(); // Add the value of register VX to the index register.
-    void OP_Fx29(); // Set the index register to the location of the sprite for the character in register VX.
-    void OP_Fx33(); // Store the binary-coded decimal representation of the value of register VX at the addresses index, index+1, and index+2.
-    void OP_Fx55(); // Store the values of registers V0 to VX inclusive in memory starting at the address in index register.
-    void OP_Fx65(); // Fill registers V0 to VX inclusive with the values stored in memory starting at the address in index register.
+    void OP_1nnn(Instruction ins); // Jump to address nnn.
+    void OP_2nnn(Instruction ins); // Execute subroutine starting at nnn.
+    void OP_3xnn(Instruction ins); // Skip next instruction if value of register VX == nn.
+    void OP_4xnn(Instruction ins); // Skip next instruction if value of register VX != nn.
+    void OP_5xy0(Instruction ins); // Skip next instruction if value of register VX == value of register VY.
+    void OP_6xnn(Instruction ins); // Set value of register VX to nn.
+    void OP_7xnn(Instruction ins); // Add nn to value of register VX.
+    void OP_8xy0(Instruction ins); // Set value of register VX to value of register VY.
+    void OP_8xy1(Instruction ins); // Set value of register VX to (value of register VX OR value of register VY).
+    void OP_8xy2(Instruction ins); // Set value of register VX to (value of register VX AND value of register VY).
+    void OP_8xy3(Instruction ins); // Set value of register VX to (value of register VX XOR value of register VY).
+    void OP_8xy4(Instruction ins); // Add value of register VY to register VX. Set VF to 1 if there is a carry, 0 if not.
+    void OP_8xy5(Instruction ins); // Subtract value of register VY from register VX. Set VF to 0 if there is a borrow, 1 if not.
+    void OP_8xy6(Instruction ins); // Store the least significant bit of register VX in register VF, then shift VX to the right by 1.
+    void OP_8xy7(Instruction ins); // Set register VX to value of register VY minus register VX. Set VF to 0 if there is a borrow, 1 if not.
+    void OP_8xyE(Instruction ins); // Store the most significant bit of register VX in register VF, then shift VX to the left by 1.
+    void OP_9xy0(Instruction ins); // Skip next instruction if (value of register VX != value of register VY).
+    void OP_Annn(Instruction ins); // Set index to address nnn.
+    void OP_Bnnn(Instruction ins); // Jump to address (nnn + value of register V0).
+    void OP_Cxnn(Instruction ins); // Set register VX to a random number with mask of nn.
+    void OP_Dxyn(Instruction ins); // Draw a sprite at position VX, VY with n bytes of sprite data starting at the address stored in index register.
+    void OP_Ex9E(Instruction ins); // Skip next instruction if key with the value of register VX is pressed.
+    void OP_ExA1(Instruction ins); // Skip next instruction if key with the value of register VX is not pressed.
+    void OP_Fx07(Instruction ins); // Set register VX to the value of the delay timer.
+    void OP_Fx0A(Instruction ins); // Wait for a key press, store the value of the key in register VX.
+    void OP_Fx15(Instruction ins); // Set the delay timer to the value of register VX.
+    void OP_Fx18(Instruction ins); // Set the sound timer to the value of register VX.
+    void OP_Fx1E(Instruction ins); // Add the value of register VX to the index register.
+    void OP_Fx29(Instruction ins); // Set the index register to the location of the sprite for the character in register VX.
+    void OP_Fx33(Instruction ins); // Store the binary-coded decimal representation of the value of register VX at the addresses index, index+1, and index+2.
+    void OP_Fx55(Instruction ins); // Store the values of registers V0 to VX inclusive in memory starting at the address in index register.
+    void OP_Fx65(Instruction ins); // Fill registers V0 to VX inclusive with the values stored in memory starting at the address in index register.
+
+    void OP_00Cn(Instruction ins); // Scroll the display down n rows.
+    void OP_00FB(); // Scroll the display right 4 columns.
+    void OP_00FC(); // Scroll the display left 4 columns.
+    void OP_00FD(); // Exit the interpreter, pc stays put.
+    void OP_00FE(); // Switch to 64x32 low resolution and clear the display.
+    void OP_00FF(); // Switch to 128x64 high resolution and clear the display.
+    void OP_Fx30(Instruction ins); // Set the index register to the location of the 8x10 sprite for the digit in register VX.
+    void OP_Fx75(Instruction ins); // Store registers V0 to VX inclusive in the flag registers.
+    void OP_Fx85(Instruction ins); // Fill registers V0 to VX inclusive from the flag registers.
+
+    void OP_00Dn(Instruction ins); // Scroll the display up n rows.
+    void OP_5xy2(Instruction ins); // Store registers VX to VY inclusive in memory starting at the address in index register.
+    void OP_5xy3(Instruction ins); // Fill registers VX to VY inclusive from memory starting at the address in index register.
+    void OP_F000(); // Set the index register to the 16-bit address in the next two bytes.
+    void OP_Fn01(Instruction ins); // Select the planes in mask n for drawing, scrolling and clearing.
+    void OP_F002(); // Load the 16-byte audio pattern from memory starting at the address in index register.
+    void OP_Fx3A(Instruction ins); // Set the audio pattern pitch to the value of register VX.
 };
+
+extern template class BasicCPU<Chip8>;
+extern template class BasicCPU<Chip8, VipQuirks>;
+extern template class BasicCPU<Chip8, Chip48Quirks>;
+extern template class BasicCPU<SuperChip>;
+extern template class BasicCPU<XoChip>;
+
+using vCPU = BasicCPU<Chip8>; // Modern quirks, the profile the block engine, snapshots and movies work with.
+
+// Instances are plain state with no pointers into themselves, so reset(), fork(), BatchEngine and snapshots copy
+// them as raw bytes.
+static_assert(std::is_trivially_copyable_v<vCPU>);
+static_assert(std::is_trivially_copyable_v<BasicCPU<SuperChip>>);
+static_assert(std::is_trivially_copyable_v<BasicCPU<XoChip>>);
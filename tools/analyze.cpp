@@ -0,0 +1,417 @@
+#include "Analyzer.h"
+#include "Disassembler.h"
+#include "RomDatabase.h"
+#include "RomStore.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Static analysis of ROMs: reachable code, basic blocks and what stands in the way of handling them ahead of time.
+// Usage: chip8-analyze [--format text|dot|json] [--profile P] [--romdb file] [--out dir] [--cache dir] [--threads N]
+//                      rom|pack.tar|dir...
+
+namespace {
+    enum class Format { Text, Dot, Json };
+
+    constexpr const char *EXTENSIONS[] = {"txt", "dot", "json"};
+
+    struct Options {
+        Format format = Format::Text;
+        Profile profile = Profile::Modern;
+        bool profileSet = false;
+        const char *romdbPath = RomDatabase::DEFAULT_PATH;
+        const char *outDir = nullptr;
+        const char *cacheDir = nullptr;
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    // One distinct ROM, analyzed once however many names it goes by.
+    struct Job {
+        const RomImage *rom;
+        Profile profile;
+        std::vector<std::string> names;
+        std::string summary; // key=value counts, one line.
+        std::string output; // Report in the chosen format.
+    };
+
+    void usage() {
+        std::cerr << "Usage: chip8-analyze [--format text|dot|json] [--profile P] [--romdb file] [--out dir]"
+                " [--cache dir] [--threads N] rom|pack.tar|dir..." << std::endl;
+    }
+
+    std::string hex(const unsigned int value, const int digits) {
+        char text[20];
+        std::snprintf(text, sizeof(text), "%0*X", digits, value);
+        return text;
+    }
+
+    std::string address(const unsigned int value) {
+        return "0x" + hex(value, 3);
+    }
+
+    const char *edgeName(const Analysis::EdgeKind kind) {
+        switch (kind) {
+            case Analysis::EdgeKind::Next: return "next";
+            case Analysis::EdgeKind::Jump: return "jump";
+            case Analysis::EdgeKind::Skip: return "skip";
+            case Analysis::EdgeKind::Call: return "call";
+            case Analysis::EdgeKind::Return: return "return";
+        }
+        return "";
+    }
+
+    std::string summarize(const Analysis &analysis) {
+        std::ostringstream out;
+        out << "profile=" << profileName(analysis.profile) << " bytes=" << analysis.size << " blocks="
+                << analysis.blocks.size() << " instructions=" << analysis.instructions << " code_bytes="
+                << analysis.codeBytes << " computed_jumps=" << analysis.computedJumps.size() << " code_writes="
+                << analysis.codeWrites.size() << " unknown_writes=" << analysis.unknownWrites.size() << " delay_waits="
+                << analysis.delayWaits.size() << " outside=" << analysis.outside.size();
+        return out.str();
+    }
+
+    // --- Reports ---
+
+    std::string writeText(const Analysis &analysis, const uint64_t hash) {
+        std::ostringstream out;
+        out << "ROM " << hex(static_cast<unsigned int>(hash >> 32), 8) << hex(static_cast<unsigned int>(hash), 8)
+                << " " << summarize(analysis) << "\n";
+
+        for (const auto &block : analysis.blocks) {
+            out << "\nblock " << address(block.start) << "-" << address(block.end) << " ->";
+            for (const auto &edge : block.successors) {
+                out << " " << address(edge.target) << " (" << edgeName(edge.kind) << ")";
+            }
+            if (block.successors.empty()) {
+                out << " none";
+            }
+            out << "\n";
+            for (const auto &ins : block.instructions) {
+                out << "  " << address(ins.address) << "  " << hex(ins.opcode, 4) << "  "
+                        << disassemble(ins.opcode, ins.operand) << "\n";
+            }
+        }
+
+        if (!analysis.computedJumps.empty() || !analysis.codeWrites.empty() || !analysis.unknownWrites.empty() ||
+            !analysis.delayWaits.empty() || !analysis.outside.empty()) {
+            out << "\n";
+        }
+        for (const auto at : analysis.computedJumps) {
+            out << "computed jump at " << address(at) << "\n";
+        }
+        for (const auto &write : analysis.codeWrites) {
+            out << "write into code at " << address(write.address) << ": " << address(write.begin) << "+"
+                    << static_cast<unsigned int>(write.length) << "\n";
+        }
+        for (const auto at : analysis.unknownWrites) {
+            out << "write to unknown address at " << address(at) << "\n";
+        }
+        for (const auto at : analysis.delayWaits) {
+            out << "delay timer wait at " << address(at) << "\n";
+        }
+        for (const auto target : analysis.outside) {
+            out << "control leaves the ROM to " << address(target) << "\n";
+        }
+        return out.str();
+    }
+
+    // Blocks as boxes listing their instructions. Jumps are bold, skips dashed, calls and returns dotted; blocks
+    // ending in a computed jump or storing into code are red.
+    std::string writeDot(const Analysis &analysis, const uint64_t hash) {
+        std::vector<uint8_t> flagged(65536);
+        for (const auto at : analysis.computedJumps) {
+            flagged[at] = 1;
+        }
+        for (const auto &write : analysis.codeWrites) {
+            flagged[write.address] = 1;
+        }
+
+        std::ostringstream out;
+        out << "digraph \"" << hex(static_cast<unsigned int>(hash >> 32), 8) << hex(static_cast<unsigned int>(hash), 8)
+                << "\" {\n  node [shape=box, fontname=\"monospace\"];\n";
+        for (const auto &block : analysis.blocks) {
+            bool red = false;
+            out << "  b" << hex(block.start, 4) << " [label=\"";
+            for (const auto &ins : block.instructions) {
+                out << address(ins.address) << "  " << disassemble(ins.opcode, ins.operand) << "\\l";
+                red |= flagged[ins.address] != 0;
+            }
+            out << "\"" << (red ? ", color=red" : "") << "];\n";
+        }
+        for (const auto &block : analysis.blocks) {
+            for (const auto &edge : block.successors) {
+                const char *style = "";
+                switch (edge.kind) {
+                    case Analysis::EdgeKind::Next: break;
+                    case Analysis::EdgeKind::Jump: style = " [style=bold]"; break;
+                    case Analysis::EdgeKind::Skip: style = " [style=dashed, label=\"skip\"]"; break;
+                    case Analysis::EdgeKind::Call: style = " [style=dotted, label=\"call\"]"; break;
+                    case Analysis::EdgeKind::Return: style = " [style=dotted, label=\"return\"]"; break;
+                }
+                out << "  b" << hex(block.start, 4) << " -> b" << hex(edge.target, 4) << style << ";\n";
+            }
+        }
+        out << "}\n";
+        return out.str();
+    }
+
+    std::string writeJson(const Analysis &analysis, const uint64_t hash) {
+        const auto list = [](std::ostringstream &out, const std::vector<uint16_t> &values) {
+            out << "[";
+            for (size_t i = 0; i < values.size(); ++i) {
+                out << (i > 0 ? ", " : "") << values[i];
+            }
+            out << "]";
+        };
+
+        std::ostringstream out;
+        out << "{\n  \"version\": " << Analysis::VERSION << ",\n  \"hash\": \""
+                << hex(static_cast<unsigned int>(hash >> 32), 8) << hex(static_cast<unsigned int>(hash), 8)
+                << "\",\n  \"profile\": \"" << profileName(analysis.profile) << "\",\n  \"bytes\": " << analysis.size
+                << ",\n  \"instructions\": " << analysis.instructions << ",\n  \"code_bytes\": " << analysis.codeBytes
+                << ",\n  \"blocks\": [";
+        for (size_t b = 0; b < analysis.blocks.size(); ++b) {
+            const auto &block = analysis.blocks[b];
+            out << (b > 0 ? "," : "") << "\n    {\"start\": " << block.start << ", \"end\": " << block.end
+                    << ", \"instructions\": [";
+            for (size_t i = 0; i < block.instructions.size(); ++i) {
+                const auto &ins = block.instructions[i];
+                out << (i > 0 ? ", " : "") << "{\"address\": " << ins.address << ", \"opcode\": \"" << hex(ins.opcode, 4)
+                        << "\", \"text\": \"" << disassemble(ins.opcode, ins.operand) << "\"}";
+            }
+            out << "], \"successors\": [";
+            for (size_t e = 0; e < block.successors.size(); ++e) {
+                out << (e > 0 ? ", " : "") << "{\"target\": " << block.successors[e].target << ", \"kind\": \""
+                        << edgeName(block.successors[e].kind) << "\"}";
+            }
+            out << "]}";
+        }
+        out << "\n  ],\n  \"computed_jumps\": ";
+        list(out, analysis.computedJumps);
+        out << ",\n  \"code_writes\": [";
+        for (size_t i = 0; i < analysis.codeWrites.size(); ++i) {
+            const auto &write = analysis.codeWrites[i];
+            out << (i > 0 ? ", " : "") << "{\"address\": " << write.address << ", \"begin\": " << write.begin
+                    << ", \"length\": " << static_cast<unsigned int>(write.length) << "}";
+        }
+        out << "],\n  \"unknown_writes\": ";
+        list(out, analysis.unknownWrites);
+        out << ",\n  \"delay_waits\": ";
+        list(out, analysis.delayWaits);
+        out << ",\n  \"outside\": ";
+        list(out, analysis.outside);
+        out << "\n}\n";
+        return out.str();
+    }
+
+    // --- Cache ---
+
+    // Reports depend only on the ROM, the profile, the format and the analyzer version, so that is the key.
+    std::filesystem::path cachePath(const Options &options, const Job &job, const char *extension) {
+        return std::filesystem::path(options.cacheDir) /
+               (hex(static_cast<unsigned int>(job.rom->hash >> 32), 8) + hex(static_cast<unsigned int>(job.rom->hash), 8) +
+                "-" + profileName(job.profile) + "-v" + std::to_string(Analysis::VERSION) + "." + extension);
+    }
+
+    bool readFile(const std::filesystem::path &path, std::string &text) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Written under a temporary name and renamed, so a reader never sees half a file.
+    void writeFile(const std::filesystem::path &path, const std::string &text) {
+        std::filesystem::path temporary = path;
+        temporary += ".tmp";
+        std::ofstream(temporary, std::ios::binary) << text;
+        std::error_code ignored;
+        std::filesystem::rename(temporary, path, ignored);
+    }
+
+    void run(const Options &options, Job &job) {
+        const char *extension = EXTENSIONS[static_cast<unsigned int>(options.format)];
+        if (options.cacheDir != nullptr && readFile(cachePath(options, job, "summary"), job.summary) &&
+            readFile(cachePath(options, job, extension), job.output)) {
+            return;
+        }
+
+        const Analysis analysis = Analyzer::analyze(job.rom->data, job.rom->size, job.profile);
+        job.summary = summarize(analysis);
+        switch (options.format) {
+            case Format::Text: job.output = writeText(analysis, job.rom->hash); break;
+            case Format::Dot: job.output = writeDot(analysis, job.rom->hash); break;
+            case Format::Json: job.output = writeJson(analysis, job.rom->hash); break;
+        }
+
+        if (options.cacheDir != nullptr) {
+            writeFile(cachePath(options, job, extension), job.output);
+            writeFile(cachePath(options, job, "summary"), job.summary);
+        }
+    }
+
+    // Files, tar packs (every ROM in them), pack.tar:member, or directories searched for both.
+    bool collect(RomStore &store, const std::string &path, std::vector<const RomImage *> &roms) {
+        const auto addPack = [&store, &roms](const std::string &pack) {
+            if (!store.loadPack(pack)) {
+                return false;
+            }
+            for (const RomImage *rom : store.images()) {
+                if (rom->name.starts_with(pack + ":")) {
+                    roms.push_back(rom);
+                }
+            }
+            return true;
+        };
+
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            std::vector<std::string> files;
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(path, error)) {
+                const std::string extension = entry.path().extension().string();
+                if (entry.is_regular_file() && (extension == ".ch8" || extension == ".c8" || extension == ".sc8" ||
+                                                extension == ".xo8" || extension == ".tar")) {
+                    files.push_back(entry.path().string());
+                }
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto &file : files) {
+                if (!(file.ends_with(".tar") ? addPack(file) : store.load(file) != nullptr)) {
+                    std::cerr << "Skipping " << file << std::endl;
+                } else if (!file.ends_with(".tar")) {
+                    roms.push_back(store.load(file));
+                }
+            }
+            return true;
+        }
+
+        if (path.ends_with(".tar")) {
+            return addPack(path);
+        }
+        const RomImage *rom = store.load(path);
+        if (rom != nullptr) {
+            roms.push_back(rom);
+        }
+        return rom != nullptr;
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "text") == 0) {
+                options.format = Format::Text;
+            } else if (std::strcmp(argv[i], "dot") == 0) {
+                options.format = Format::Dot;
+            } else if (std::strcmp(argv[i], "json") == 0) {
+                options.format = Format::Json;
+            } else {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (!parseProfile(argv[++i], options.profile)) {
+                usage();
+                return 1;
+            }
+            options.profileSet = true;
+        } else if (std::strcmp(argv[i], "--romdb") == 0 && i + 1 < argc) {
+            options.romdbPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            options.outDir = argv[++i];
+        } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            inputs.emplace_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        usage();
+        return 1;
+    }
+
+    RomStore store;
+    std::vector<const RomImage *> roms;
+    for (const auto &input : inputs) {
+        if (!collect(store, input, roms)) {
+            std::cerr << "Failed to load ROM: " << input << std::endl;
+            return 1;
+        }
+    }
+
+    RomDatabase database;
+    if (!options.profileSet) {
+        database.load(options.romdbPath);
+    }
+
+    // The same ROM under several names is analyzed once.
+    std::vector<Job> jobs;
+    std::map<uint64_t, size_t> jobFor;
+    std::vector<size_t> order;
+    for (const RomImage *rom : roms) {
+        const auto [it, added] = jobFor.try_emplace(rom->hash, jobs.size());
+        if (added) {
+            jobs.push_back({rom, options.profileSet ? options.profile : database.lookup(rom->hash), {}, {}, {}});
+        }
+        jobs[it->second].names.push_back(rom->name);
+        order.push_back(it->second);
+    }
+
+    for (const char *dir : {options.cacheDir, options.outDir}) {
+        if (dir != nullptr) {
+            std::filesystem::create_directories(dir);
+        }
+    }
+
+    ThreadPool pool(options.threads);
+    pool.parallelFor(jobs.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            run(options, jobs[j]);
+        }
+    });
+
+    // One ROM without --out prints its report. Otherwise each report goes to <out>/<hash>.<format> and stdout
+    // gets a summary line per ROM.
+    if (roms.size() == 1 && options.outDir == nullptr) {
+        std::cout << jobs[0].output;
+        return 0;
+    }
+
+    for (size_t r = 0; r < roms.size(); ++r) {
+        const Job &job = jobs[order[r]];
+        const std::string hash = hex(static_cast<unsigned int>(job.rom->hash >> 32), 8) +
+                                 hex(static_cast<unsigned int>(job.rom->hash), 8);
+        std::cout << hash << " " << roms[r]->name << " " << job.summary << std::endl;
+    }
+    if (options.outDir != nullptr) {
+        for (const auto &job : jobs) {
+            const std::string hash = hex(static_cast<unsigned int>(job.rom->hash >> 32), 8) +
+                                     hex(static_cast<unsigned int>(job.rom->hash), 8);
+            writeFile(std::filesystem::path(options.outDir) /
+                      (hash + "." + EXTENSIONS[static_cast<unsigned int>(options.format)]), job.output);
+        }
+    }
+}
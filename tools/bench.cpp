@@ -0,0 +1,860 @@
+#include "BatchEngine.h"
+#include "BlockEngine.h"
+#include "LockstepBatch.h"
+#include "PostProcess.h"
+#include "Rewind.h"
+#include "RomStore.h"
+#include "SaveState.h"
+#include "ThreadPool.h"
+#include "vCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Benchmarks for the emulator core.
+// Usage: chip8-bench [--rom path] [--instances N] [--cycles N] [--steps N] [--threads N] [--min-time S]
+//                    [--repetitions N] [--json] [benchmark...]
+
+namespace {
+    // Default workload: ALU chains, BCD, a subroutine call, a sprite draw and a key check in a loop.
+    const uint8_t WORKLOAD[] = {
+        0x00, 0xE0, 0x60, 0x00, 0x61, 0x00, 0x62, 0x05, 0x63, 0x01, 0x70, 0x01, 0x81, 0x04, 0x82, 0x34,
+        0x83, 0x15, 0x80, 0x26, 0x80, 0x1E, 0x81, 0x27, 0x83, 0x03, 0x82, 0x31, 0x83, 0x12, 0xC3, 0x0F,
+        0xA3, 0x00, 0xF3, 0x33, 0xF2, 0x65, 0x64, 0x10, 0x65, 0x08, 0xA2, 0x42, 0xD4, 0x55, 0x22, 0x3A,
+        0x3A, 0x00, 0x7A, 0xFF, 0xE1, 0x9E, 0x7B, 0x01, 0x12, 0x0A, 0x8E, 0x00, 0x8E, 0xF4, 0x8F, 0xE5,
+        0x00, 0xEE, 0xFF, 0x81, 0xA5, 0x81, 0xBD, 0x99, 0x81, 0xFF
+    };
+
+    struct Options {
+        const char *rom = nullptr;
+        size_t instances = 1024;
+        unsigned int cycles = 1000; // Per instance per step.
+        unsigned int steps = 50;
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+        double minTime = 0.05; // Seconds a timed batch has to take, see measure().
+        unsigned int repetitions = 5;
+        bool json = false;
+        const RomImage *image = nullptr; // --rom, loaded by main().
+    };
+
+    void loadWorkload(vCPU &cpu, const Options &options) {
+        if (options.image != nullptr) {
+            cpu.loadROM(options.image->data, options.image->size);
+        } else {
+            std::memcpy(&cpu.memory[vCPU::START_ADDRESS], WORKLOAD, sizeof(WORKLOAD));
+            cpu.invalidate(vCPU::START_ADDRESS, sizeof(WORKLOAD));
+        }
+    }
+
+    double seconds(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // One line of output: a name unique across runs and fields kept in the order they were set, so results can
+    // be diffed between versions.
+    class Result {
+    public:
+        explicit Result(std::string name) : name(std::move(name)) {}
+
+        template <typename T>
+        Result &set(const char *key, const T value) {
+            if constexpr (std::is_same_v<T, bool>) {
+                fields.push_back({key, value ? "true" : "false", false});
+            } else if constexpr (std::is_integral_v<T>) {
+                fields.push_back({key, std::to_string(value), false});
+            } else if constexpr (std::is_floating_point_v<T>) {
+                char text[32] = "null"; // JSON has no inf or nan.
+                if (std::isfinite(value)) {
+                    std::snprintf(text, sizeof(text), "%.6g", static_cast<double>(value));
+                }
+                fields.push_back({key, text, false});
+            } else {
+                fields.push_back({key, std::string(value), true});
+            }
+            return *this;
+        }
+
+    private:
+        friend class Reporter;
+
+        struct Field {
+            std::string key;
+            std::string value;
+            bool quoted;
+        };
+
+        std::string name;
+        std::vector<Field> fields;
+    };
+
+    // Prints results as they come in, or collects them into one JSON document printed by finish().
+    class Reporter {
+    public:
+        explicit Reporter(const Options &options) : options(options) {}
+
+        void add(Result result) {
+            if (options.json) {
+                results.push_back(std::move(result));
+                return;
+            }
+            std::cout << result.name;
+            for (const auto &field : result.fields) {
+                std::cout << " " << field.key << "=" << field.value;
+            }
+            std::cout << std::endl;
+        }
+
+        void finish() const {
+            if (!options.json) {
+                return;
+            }
+            Result context("context");
+            context.set("schema", 1)
+                    .set("cpus", std::thread::hardware_concurrency())
+                    .set("min_time", options.minTime)
+                    .set("repetitions", options.repetitions)
+#ifdef NDEBUG
+                    .set("build", "release")
+#else
+                    .set("build", "debug")
+#endif
+#ifdef CHIP8_PROFILE
+                    .set("profiler", true);
+#else
+                    .set("profiler", false);
+#endif
+
+            std::cout << "{\n  \"context\": {";
+            writeFields(context, "\n    ");
+            std::cout << "\n  },\n  \"benchmarks\": [";
+            for (size_t i = 0; i < results.size(); ++i) {
+                std::cout << (i > 0 ? ",\n    {" : "\n    {") << "\n      \"name\": " << quote(results[i].name);
+                if (!results[i].fields.empty()) {
+                    std::cout << ",";
+                }
+                writeFields(results[i], "\n      ");
+                std::cout << "\n    }";
+            }
+            std::cout << "\n  ]\n}" << std::endl;
+        }
+
+    private:
+        static std::string quote(const std::string &text) {
+            std::string quoted = "\"";
+            for (const char c : text) {
+                if (c == '"' || c == '\\') {
+                    quoted += '\\';
+                    quoted += c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    quoted += escape;
+                } else {
+                    quoted += c;
+                }
+            }
+            return quoted + "\"";
+        }
+
+        static void writeFields(const Result &result, const char *indent) {
+            for (size_t i = 0; i < result.fields.size(); ++i) {
+                const auto &field = result.fields[i];
+                std::cout << (i > 0 ? "," : "") << indent << quote(field.key) << ": "
+                        << (field.quoted ? quote(field.value) : field.value);
+            }
+        }
+
+        const Options &options;
+        std::vector<Result> results;
+    };
+
+    // Google Benchmark style timing. The batch size doubles, or jumps to the estimate once a batch is long enough
+    // to time, until one batch takes --min-time, then --repetitions batches of that size are timed.
+    struct Timing {
+        uint64_t iterations = 0; // Per batch.
+        double median = 0; // Nanoseconds per iteration.
+        double min = 0;
+        double max = 0;
+    };
+
+    template <typename Batch>
+    Timing measure(const Options &options, Batch &&batch) {
+        const auto time = [&batch](const uint64_t iterations) {
+            const auto start = std::chrono::steady_clock::now();
+            batch(iterations);
+            return seconds(start);
+        };
+
+        Timing timing;
+        timing.iterations = 1;
+        for (double elapsed; (elapsed = time(timing.iterations)) < options.minTime;) {
+            timing.iterations = elapsed < options.minTime / 100 ? timing.iterations * 2 :
+                                static_cast<uint64_t>(static_cast<double>(timing.iterations) * options.minTime * 1.2 / elapsed) + 1;
+        }
+
+        std::vector<double> samples(std::max(1u, options.repetitions));
+        for (auto &sample : samples) {
+            sample = time(timing.iterations) * 1e9 / static_cast<double>(timing.iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+        timing.median = samples[samples.size() / 2];
+        timing.min = samples.front();
+        timing.max = samples.back();
+        return timing;
+    }
+
+    // A timed result, per_second counts units.
+    Result timed(std::string name, const char *unit, const Timing &timing) {
+        return std::move(Result(std::move(name))
+                .set("unit", unit)
+                .set("iterations", timing.iterations)
+                .set("ns_median", timing.median)
+                .set("ns_min", timing.min)
+                .set("ns_max", timing.max)
+                .set("per_second", 1e9 / timing.median));
+    }
+
+    // Aggregate emulated cycles/sec of BatchEngine for 1, 2, 4... threads up to --threads.
+    void benchBatch(const Options &options, Reporter &reporter) {
+        vCPU prototype;
+        loadWorkload(prototype, options);
+
+        std::vector<uint16_t> keys(options.instances);
+        double single = 0;
+
+        for (unsigned int threads = 1;; threads = std::min(threads * 2, options.threads)) {
+            ThreadPool pool(threads);
+            BatchEngine batch(options.instances, prototype, pool);
+
+            batch.step(keys.data(), options.cycles); // Warm up.
+
+            const auto start = std::chrono::steady_clock::now();
+            for (unsigned int s = 0; s < options.steps; ++s) {
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    keys[i] = static_cast<uint16_t>(1u << ((i + s) % 16));
+                }
+                batch.step(keys.data(), options.cycles);
+            }
+            const double elapsed = seconds(start);
+
+            const double total = static_cast<double>(options.instances) * options.cycles * options.steps;
+            const double rate = total / elapsed;
+            if (threads == 1) {
+                single = rate;
+            }
+
+            reporter.add(Result("batch/threads=" + std::to_string(threads))
+                    .set("instances", options.instances)
+                    .set("cycles_per_second", rate)
+                    .set("speedup", rate / single));
+
+            if (threads == options.threads) {
+                break;
+            }
+        }
+    }
+
+    // Lane-cycles/sec of LockstepBatch against the scalar BatchEngine path, both on one thread.
+    void benchLockstep(const Options &options, Reporter &reporter) {
+        vCPU prototype;
+        loadWorkload(prototype, options);
+
+        const size_t groups = std::max<size_t>(1, options.instances / LockstepBatch::LANES);
+        const size_t instances = groups * LockstepBatch::LANES;
+        const double total = static_cast<double>(instances) * options.cycles * options.steps;
+
+        // Keys and seeds differ per lane, so lanes diverge at key checks and on Cxnn and have to reconverge.
+        std::vector<uint16_t> keys(instances);
+        for (size_t i = 0; i < instances; ++i) {
+            keys[i] = static_cast<uint16_t>(1u << (i % 16));
+        }
+
+        ThreadPool pool(1);
+        BatchEngine scalar(instances, prototype, pool);
+        for (size_t i = 0; i < instances; ++i) {
+            scalar.instance(i).seed(i);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int s = 0; s < options.steps; ++s) {
+            scalar.step(keys.data(), options.cycles);
+        }
+        const double scalarRate = total / seconds(start);
+
+        std::vector<LockstepBatch> batches(groups, LockstepBatch(prototype));
+        for (size_t g = 0; g < groups; ++g) {
+            batches[g].setKeys(&keys[g * LockstepBatch::LANES]);
+            for (unsigned int l = 0; l < LockstepBatch::LANES; ++l) {
+                batches[g].seed(l, g * LockstepBatch::LANES + l);
+            }
+        }
+        start = std::chrono::steady_clock::now();
+        for (unsigned int s = 0; s < options.steps; ++s) {
+            for (auto &batch : batches) {
+                batch.run(options.cycles);
+            }
+        }
+        const double lockstepRate = total / seconds(start);
+
+        uint64_t vectorSteps = 0;
+        uint64_t scalarSteps = 0;
+        size_t mismatches = 0;
+        for (size_t g = 0; g < groups; ++g) {
+            vectorSteps += batches[g].vectorSteps;
+            scalarSteps += batches[g].scalarSteps;
+            for (unsigned int l = 0; l < LockstepBatch::LANES; ++l) {
+                const size_t i = g * LockstepBatch::LANES + l;
+                mismatches += BatchEngine::stateHash(batches[g].lane(l)) != scalar.output()[i].hash;
+            }
+        }
+
+        reporter.add(Result("lockstep")
+                .set("lanes", LockstepBatch::LANES)
+                .set("instances", instances)
+                .set("scalar_cycles_per_second", scalarRate)
+                .set("lockstep_cycles_per_second", lockstepRate)
+                .set("speedup", lockstepRate / scalarRate)
+                .set("vector_steps", vectorSteps)
+                .set("scalar_steps", scalarSteps)
+                .set("mismatches", mismatches));
+    }
+
+    // Snapshots/sec and bytes per snapshot, full and delta, taking one snapshot per frame of 10 cycles.
+    void benchSnapshot(const Options &options, Reporter &reporter) {
+        constexpr unsigned int CYCLES_PER_FRAME = 10;
+        const size_t frames = static_cast<size_t>(options.steps) * options.cycles / CYCLES_PER_FRAME;
+
+        vCPU cpu;
+        loadWorkload(cpu, options);
+        const vCPU start = cpu;
+
+        // Full snapshots, timed without the emulation between them.
+        SaveState state;
+        double saveTime = 0;
+        double loadTime = 0;
+        for (size_t f = 0; f < frames; ++f) {
+            cpu.keypad[f % 16] ^= 1u;
+            cpu.run(CYCLES_PER_FRAME);
+
+            auto t = std::chrono::steady_clock::now();
+            cpu.saveState(state);
+            saveTime += seconds(t);
+
+            t = std::chrono::steady_clock::now();
+            cpu.loadState(state);
+            loadTime += seconds(t);
+        }
+
+        // Deltas over the same run, then decoded back to check they reproduce the final state.
+        cpu = start;
+        DeltaEncoder encoder;
+        std::vector<uint8_t> deltas;
+        deltas.reserve(frames * 512);
+        double deltaTime = 0;
+        for (size_t f = 0; f < frames; ++f) {
+            cpu.keypad[f % 16] ^= 1u;
+            cpu.run(CYCLES_PER_FRAME);
+
+            const auto t = std::chrono::steady_clock::now();
+            encoder.encode(cpu, deltas);
+            deltaTime += seconds(t);
+        }
+
+        SaveState decoded;
+        const auto t = std::chrono::steady_clock::now();
+        for (size_t offset = 0, used; offset < deltas.size(); offset += used) {
+            used = DeltaEncoder::apply(decoded, &deltas[offset], deltas.size() - offset);
+            if (used == 0) {
+                break;
+            }
+        }
+        const double applyTime = seconds(t);
+
+        cpu.saveState(state);
+        const bool match = std::memcmp(&state, &decoded, sizeof(state)) == 0;
+
+        reporter.add(Result("snapshot")
+                .set("frames", frames)
+                .set("full_bytes", sizeof(SaveState))
+                .set("saves_per_second", frames / saveTime)
+                .set("loads_per_second", frames / loadTime)
+                .set("delta_bytes", static_cast<double>(deltas.size()) / frames)
+                .set("deltas_per_second", frames / deltaTime)
+                .set("applies_per_second", frames / applyTime)
+                .set("roundtrip", match ? "ok" : "MISMATCH"));
+    }
+
+    // Capture cost, memory per frame and step-back latency of Rewind, one capture per frame of 10 cycles.
+    void benchRewind(const Options &options, Reporter &reporter) {
+        constexpr unsigned int CYCLES_PER_FRAME = 10;
+        constexpr size_t MAX_BYTES = 4 << 20;
+        const size_t frames = static_cast<size_t>(options.steps) * options.cycles / CYCLES_PER_FRAME;
+
+        vCPU cpu;
+        loadWorkload(cpu, options);
+        SaveState first;
+        cpu.saveState(first);
+
+        Rewind rewind(MAX_BYTES, frames);
+        double captureTime = 0;
+        for (size_t f = 0; f <= frames; ++f) {
+            const auto t = std::chrono::steady_clock::now();
+            rewind.capture(cpu);
+            captureTime += seconds(t);
+
+            cpu.keypad[f % 16] ^= 1u;
+            cpu.run(CYCLES_PER_FRAME);
+        }
+
+        const size_t held = rewind.frames();
+        const size_t bytes = rewind.bytesUsed();
+
+        double stepTime = 0;
+        double worst = 0;
+        for (size_t f = 0; f < held; ++f) {
+            const auto t = std::chrono::steady_clock::now();
+            rewind.stepBack(cpu);
+            const double elapsed = seconds(t);
+            stepTime += elapsed;
+            worst = std::max(worst, elapsed);
+        }
+
+        // With the whole run held, stepping all the way back has to land on the first frame.
+        SaveState last;
+        cpu.saveState(last);
+        const char *check = held < frames ? "partial" :
+                            std::memcmp(&first, &last, sizeof(last)) == 0 ? "ok" : "MISMATCH";
+
+        reporter.add(Result("rewind")
+                .set("frames", frames)
+                .set("held", held)
+                .set("bytes", bytes)
+                .set("bytes_per_frame", held > 0 ? static_cast<double>(bytes) / held : 0)
+                .set("footprint", rewind.footprint())
+                .set("captures_per_second", (frames + 1) / captureTime)
+                .set("step_back_us_avg", (held > 0 ? stepTime / held : 0) * 1e6)
+                .set("step_back_us_max", worst * 1e6)
+                .set("roundtrip", check));
+    }
+
+    // One instruction repeated KERNEL_LENGTH times and a jump back, so one cycle in KERNEL_LENGTH + 1 is the jump.
+    // Kernels start with V0 = 0, V1 = 3, V2 = 5, key 0 held, index at 256 bytes of 0xAA and a 00EE at SUBROUTINE,
+    // chosen so no skip is ever taken.
+    struct Kernel {
+        const char *name;
+        uint16_t opcode; // nnn of 1nnn and Bnnn is filled in with the address of the next instruction.
+        uint16_t operand = 0; // Second word of a four-byte instruction.
+    };
+
+    constexpr unsigned int KERNEL_LENGTH = 32;
+    constexpr uint16_t SUBROUTINE = 0xF00;
+    constexpr uint16_t KERNEL_DATA = 0x800;
+
+    const Kernel CHIP8_KERNELS[] = {
+        {"OP_NULL", 0x0123}, {"OP_00E0", 0x00E0}, {"OP_2nnn+OP_00EE", 0x2000 | SUBROUTINE}, {"OP_1nnn", 0x1000},
+        {"OP_3xnn", 0x3001}, {"OP_4xnn", 0x4000}, {"OP_5xy0", 0x5010}, {"OP_6xnn", 0x6312}, {"OP_7xnn", 0x7301},
+        {"OP_8xy0", 0x8310}, {"OP_8xy1", 0x8311}, {"OP_8xy2", 0x8312}, {"OP_8xy3", 0x8313}, {"OP_8xy4", 0x8314},
+        {"OP_8xy5", 0x8315}, {"OP_8xy6", 0x8316}, {"OP_8xy7", 0x8317}, {"OP_8xyE", 0x831E}, {"OP_9xy0", 0x9000},
+        {"OP_Annn", 0xA000 | KERNEL_DATA}, {"OP_Bnnn", 0xB000}, {"OP_Cxnn", 0xC3FF}, {"OP_Dxyn", 0xD125},
+        {"OP_Ex9E", 0xE19E}, {"OP_ExA1", 0xE0A1}, {"OP_Fx07", 0xF307}, {"OP_Fx0A", 0xF30A}, {"OP_Fx15", 0xF015},
+        {"OP_Fx18", 0xF018}, {"OP_Fx1E", 0xF01E}, {"OP_Fx29", 0xF329}, {"OP_Fx33", 0xF333}, {"OP_Fx55", 0xFF55},
+        {"OP_Fx65", 0xFF65},
+    };
+
+    const Kernel SUPER_CHIP_KERNELS[] = {
+        {"OP_00Cn", 0x00C1}, {"OP_00FB", 0x00FB}, {"OP_00FC", 0x00FC}, {"OP_00FD", 0x00FD}, {"OP_00FE", 0x00FE},
+        {"OP_00FF", 0x00FF}, {"OP_Fx30", 0xF330}, {"OP_Fx75", 0xF775}, {"OP_Fx85", 0xF785},
+    };
+
+    const Kernel XO_CHIP_KERNELS[] = {
+        {"OP_00Dn", 0x00D1}, {"OP_5xy2", 0x5012}, {"OP_5xy3", 0x5013}, {"OP_F000", 0xF000, KERNEL_DATA},
+        {"OP_Fn01", 0xF301}, {"OP_F002", 0xF002}, {"OP_Fx3A", 0xF33A},
+    };
+
+    template <typename CPU>
+    void loadKernel(CPU &cpu, const Kernel &kernel) {
+        unsigned int address = CPU::START_ADDRESS;
+        const auto put = [&cpu, &address](const uint16_t word) {
+            cpu.memory[address++] = static_cast<uint8_t>(word >> 8u);
+            cpu.memory[address++] = static_cast<uint8_t>(word);
+        };
+
+        for (unsigned int i = 0; i < KERNEL_LENGTH; ++i) {
+            const bool jumps = (kernel.opcode & 0xF000u) == 0x1000u || (kernel.opcode & 0xF000u) == 0xB000u;
+            put(jumps ? kernel.opcode | (address + 2) : kernel.opcode);
+            if (kernel.operand != 0) {
+                put(kernel.operand);
+            }
+        }
+        put(0x1000 | CPU::START_ADDRESS);
+
+        std::memset(&cpu.memory[KERNEL_DATA], 0xAA, 256);
+        cpu.memory[SUBROUTINE] = 0x00;
+        cpu.memory[SUBROUTINE + 1] = 0xEE;
+        cpu.invalidate(0, CPU::MEMORY);
+
+        cpu.registers[1] = 3;
+        cpu.registers[2] = 5;
+        cpu.keypad[0] = 1;
+        cpu.index = KERNEL_DATA;
+    }
+
+    template <typename CPU>
+    void benchKernels(const Options &options, Reporter &reporter, const std::span<const Kernel> kernels) {
+        for (const auto &kernel : kernels) {
+            const auto cpu = std::make_unique<CPU>(0);
+            loadKernel(*cpu, kernel);
+            reporter.add(timed(std::string("opcode/") + kernel.name, "cycle",
+                               measure(options, [&cpu](const uint64_t cycles) { cpu->run(cycles); })));
+        }
+    }
+
+    // Cost per instruction of each handler through vCPU::run(), fetch and dispatch included. The SUPER-CHIP and
+    // XO-CHIP handlers run on their own machines.
+    void benchOpcodes(const Options &options, Reporter &reporter) {
+        benchKernels<vCPU>(options, reporter, CHIP8_KERNELS);
+        benchKernels<BasicCPU<SuperChip>>(options, reporter, SUPER_CHIP_KERNELS);
+        benchKernels<BasicCPU<XoChip>>(options, reporter, XO_CHIP_KERNELS);
+    }
+
+    // Dxyn by sprite height and position. Sprites at x 60 or y 28 cross the edge, which clips on CHIP-8 and wraps
+    // on XO-CHIP; x 3 straddles no word but needs shifting.
+    void benchDraw(const Options &options, Reporter &reporter) {
+        struct Position {
+            uint8_t x;
+            uint8_t y;
+        };
+        constexpr Position POSITIONS[] = {{0, 0}, {3, 10}, {60, 10}, {3, 28}, {60, 28}};
+
+        const auto run = [&]<typename CPU>(const char *machine, const unsigned int height, const Position position,
+                                           const bool hires) {
+            const auto cpu = std::make_unique<CPU>(0);
+            loadKernel(*cpu, {"OP_Dxyn", static_cast<uint16_t>(0xD010 | height)});
+            cpu->registers[0] = position.x;
+            cpu->registers[1] = position.y;
+            cpu->hires = hires;
+            const std::string name = std::string("draw/") + machine + "/h=" + std::to_string(height == 0 ? 16 : height) +
+                                     "/x=" + std::to_string(position.x) + ",y=" + std::to_string(position.y);
+            reporter.add(timed(name, "cycle", measure(options, [&cpu](const uint64_t cycles) { cpu->run(cycles); })));
+        };
+
+        for (const unsigned int height : {1u, 5u, 8u, 15u}) {
+            for (const auto position : POSITIONS) {
+                run.operator()<vCPU>("chip8", height, position, false);
+            }
+        }
+        for (const auto position : POSITIONS) {
+            run.operator()<BasicCPU<XoChip>>("xochip-lores", 8, position, false);
+            run.operator()<BasicCPU<XoChip>>("xochip-hires", 0, Position{static_cast<uint8_t>(position.x * 2),
+                                                                         static_cast<uint8_t>(position.y * 2)}, true);
+        }
+    }
+
+    // ROMs for the rom, load and reset benchmarks: the built-in workload, written to a temporary file while they
+    // run, then --rom or else the bundled test ROM. Git LFS leaves a text pointer in place of the ROM when the real
+    // file was never fetched, which is not worth timing.
+    class RomFiles {
+    public:
+        struct Rom {
+            std::string name;
+            std::string path; // Empty for a ROM in a pack, which has no file of its own.
+            const RomImage *image;
+        };
+
+        RomFiles(const Options &options, Reporter &reporter, const std::string &prefix) {
+            temporary = std::filesystem::temp_directory_path() / "chip8-bench-workload.ch8";
+            std::ofstream(temporary, std::ios::binary).write(reinterpret_cast<const char *>(WORKLOAD), sizeof(WORKLOAD));
+            if (const RomImage *image = store.load(temporary.string()); image != nullptr) {
+                roms.push_back({"workload", temporary.string(), image});
+            }
+
+            const std::string path = options.rom != nullptr ? options.rom : "assets/test.ch8";
+            const std::string name = std::filesystem::path(path).filename().string();
+            const RomImage *image = store.load(path);
+            const char *problem = image == nullptr ? "unreadable" :
+                                  image->size >= 8 && std::memcmp(image->data, "version ", 8) == 0 ? "git-lfs pointer" :
+                                  image->size > vCPU::MEMORY - vCPU::START_ADDRESS ? "too large" : nullptr;
+            if (problem != nullptr) {
+                reporter.add(Result(prefix + name).set("skipped", problem));
+            } else {
+                roms.push_back({name, path.find(".tar:") == std::string::npos ? path : "", image});
+            }
+        }
+
+        ~RomFiles() {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+        }
+
+        [[nodiscard]] const std::vector<Rom> &list() const { return roms; }
+
+    private:
+        RomStore store;
+        std::filesystem::path temporary;
+        std::vector<Rom> roms;
+    };
+
+    // Whole-program throughput through cycle(), the way the frontend steps, through run() and through the block
+    // engine, on the built-in workload and the ROM files. vs_run is the block engine's speedup over run().
+    void benchRom(const Options &options, Reporter &reporter) {
+        const RomFiles files(options, reporter, "rom/");
+        std::vector<std::pair<std::string, std::unique_ptr<vCPU>>> programs;
+        for (const auto &rom : files.list()) {
+            programs.emplace_back(rom.name, std::make_unique<vCPU>(0));
+            programs.back().second->loadROM(rom.image->data, rom.image->size);
+        }
+
+        for (const auto &[name, prototype] : programs) {
+            auto cpu = std::make_unique<vCPU>(*prototype);
+            reporter.add(timed("rom/" + name + "/cycle", "cycle", measure(options, [&cpu](const uint64_t cycles) {
+                for (uint64_t i = 0; i < cycles; ++i) {
+                    cpu->cycle();
+                }
+            })));
+
+            *cpu = *prototype;
+            const Timing interpreted = measure(options, [&cpu](const uint64_t cycles) { cpu->run(cycles); });
+            reporter.add(timed("rom/" + name + "/run", "cycle", interpreted));
+
+            *cpu = *prototype;
+            BlockEngine engine(*cpu);
+            const Timing block = measure(options, [&engine](const uint64_t cycles) { engine.run(cycles); });
+            reporter.add(timed("rom/" + name + "/block", "cycle", block).set("vs_run", interpreted.median / block.median));
+        }
+    }
+
+    // Display to one 32-bit RGBA value per pixel into a buffer reused across frames, on a half-lit screen.
+    void benchExpand(const Options &options, Reporter &reporter) {
+        const auto run = [&]<typename CPU>(const char *machine) {
+            const auto cpu = std::make_unique<CPU>(0);
+            uint64_t pattern = 0x9E3779B97F4A7C15ull;
+            for (auto &word : cpu->video) {
+                pattern ^= pattern << 13u;
+                pattern ^= pattern >> 7u;
+                pattern ^= pattern << 17u;
+                word = pattern;
+            }
+
+            std::vector<uint32_t> pixels(CPU::WIDTH * CPU::HEIGHT);
+            reporter.add(timed(std::string("expand/") + machine, "frame", measure(options, [&](const uint64_t frames) {
+                for (uint64_t f = 0; f < frames; ++f) {
+                    cpu->expandVideo(pixels.data(), 0xFFFFFFFFu, 0x000000FFu);
+                }
+            })));
+        };
+
+        run.operator()<vCPU>("chip8");
+        run.operator()<BasicCPU<SuperChip>>("schip");
+        run.operator()<BasicCPU<XoChip>>("xochip");
+    }
+
+    // Window output: phosphor decay, integer upscale and scanlines into RGBA at the scale that fits common
+    // window heights, plus the XO-CHIP display (128x64, two planes) at 1080p. "changing" flips between two random
+    // frames, so every row is redrawn each time; "still" is a settled display where nothing needs drawing or
+    // uploading.
+    void benchPostProcess(const Options &options, Reporter &reporter) {
+        uint64_t frames[2][XoChip::PLANES * XoChip::HEIGHT * XoChip::WIDTH / 64];
+        uint64_t pattern = 0x9E3779B97F4A7C15ull;
+        for (auto &frame : frames) {
+            for (auto &row : frame) {
+                pattern ^= pattern << 13u;
+                pattern ^= pattern >> 7u;
+                pattern ^= pattern << 17u;
+                row = pattern;
+            }
+        }
+
+        struct Display {
+            const char *name;
+            unsigned int width, height, planes, scale;
+        };
+        for (const auto &[name, width, height, planes, scale] : {Display{"720p", 64, 32, 1, 20},
+                                                                 Display{"1080p", 64, 32, 1, 30},
+                                                                 Display{"2160p", 64, 32, 1, 60},
+                                                                 Display{"xochip-1080p", 128, 64, 2, 15}}) {
+            PostProcess post(width, height, planes, {scale, 192, 160});
+            const size_t bytes = static_cast<size_t>(post.outputWidth()) * post.outputHeight() * 4;
+
+            uint64_t frame = 0;
+            reporter.add(timed(std::string("post/") + name + "/changing", "frame",
+                               measure(options, [&](const uint64_t count) {
+                                   for (uint64_t f = 0; f < count; ++f) {
+                                       post.process(frames[frame++ & 1u]);
+                                   }
+                               })).set("bytes", bytes));
+
+            for (unsigned int f = 0; f < 64; ++f) {
+                post.process(frames[0]);
+            }
+            reporter.add(timed(std::string("post/") + name + "/still", "frame",
+                               measure(options, [&](const uint64_t count) {
+                                   for (uint64_t f = 0; f < count; ++f) {
+                                       post.process(frames[0]);
+                                   }
+                               })));
+            // The same with the frontend's dirty rows, which are all clean: nothing left to expand.
+            reporter.add(timed(std::string("post/") + name + "/clean", "frame",
+                               measure(options, [&](const uint64_t count) {
+                                   for (uint64_t f = 0; f < count; ++f) {
+                                       post.process(frames[0], 0);
+                                   }
+                               })));
+        }
+    }
+
+    // Startup: constructing a vCPU and reading a ROM file into it. ROMs in packs are left out.
+    void benchLoad(const Options &options, Reporter &reporter) {
+        const RomFiles files(options, reporter, "load/");
+        for (const auto &rom : files.list()) {
+            if (rom.path.empty()) {
+                continue;
+            }
+            reporter.add(timed("load/" + rom.name, "load", measure(options, [&rom](const uint64_t loads) {
+                for (uint64_t i = 0; i < loads; ++i) {
+                    const auto cpu = std::make_unique<vCPU>(0);
+                    cpu->loadROM(rom.path.c_str());
+                }
+            })));
+        }
+    }
+
+    // Putting an existing vCPU back to power-on with a ROM loaded, as episode restarts do: by reading the file
+    // again, by copying the image a RomStore holds into a blank vCPU, or with reset() from a boot image, whose bytes
+    // are what each reset copies. Forking a running instance and the size of each machine's state are reported
+    // alongside.
+    void benchReset(const Options &options, Reporter &reporter) {
+        const RomFiles files(options, reporter, "reset/");
+        const auto blank = std::make_unique<vCPU>(0);
+        const auto cpu = std::make_unique<vCPU>(0);
+
+        for (const auto &rom : files.list()) {
+            if (!rom.path.empty()) {
+                reporter.add(timed("reset/" + rom.name + "/file", "reset", measure(options, [&](const uint64_t resets) {
+                    for (uint64_t i = 0; i < resets; ++i) {
+                        *cpu = *blank;
+                        cpu->loadROM(rom.path.c_str());
+                    }
+                })));
+            }
+            reporter.add(timed("reset/" + rom.name + "/store", "reset", measure(options, [&](const uint64_t resets) {
+                for (uint64_t i = 0; i < resets; ++i) {
+                    *cpu = *blank;
+                    cpu->loadROM(rom.image->data, rom.image->size);
+                }
+            })));
+
+            const auto boot = std::make_unique<vCPU>(0);
+            boot->loadROM(rom.image->data, rom.image->size);
+            reporter.add(timed("reset/" + rom.name + "/boot", "reset", measure(options, [&](const uint64_t resets) {
+                for (uint64_t i = 0; i < resets; ++i) {
+                    cpu->reset(*boot);
+                }
+            })).set("bytes", sizeof(vCPU)));
+
+            // Fork mid-run, from an instance that has drawn something.
+            cpu->reset(*boot);
+            cpu->run(10000);
+            const auto clone = std::make_unique<vCPU>(0);
+            reporter.add(timed("fork/" + rom.name, "fork", measure(options, [&](const uint64_t forks) {
+                for (uint64_t i = 0; i < forks; ++i) {
+                    new(clone.get()) vCPU(cpu->fork()); // Built in place, where assigning would copy twice.
+                }
+            })));
+        }
+
+        reporter.add(Result("instance/chip8").set("bytes", sizeof(vCPU)));
+        reporter.add(Result("instance/schip").set("bytes", sizeof(BasicCPU<SuperChip>)));
+        reporter.add(Result("instance/xochip").set("bytes", sizeof(BasicCPU<XoChip>)));
+    }
+
+    struct Benchmark {
+        const char *name;
+        std::function<void(const Options &, Reporter &)> run;
+    };
+
+    const Benchmark BENCHMARKS[] = {
+        {"batch", benchBatch},
+        {"lockstep", benchLockstep},
+        {"snapshot", benchSnapshot},
+        {"rewind", benchRewind},
+        {"opcodes", benchOpcodes},
+        {"draw", benchDraw},
+        {"rom", benchRom},
+        {"expand", benchExpand},
+        {"post", benchPostProcess},
+        {"load", benchLoad},
+        {"reset", benchReset},
+    };
+
+    void usage() {
+        std::cerr << "Usage: chip8-bench [--rom path] [--instances N] [--cycles N] [--steps N] [--threads N] [--min-time S]"
+                " [--repetitions N] [--json] [benchmark...]" << std::endl;
+        std::cerr << "Benchmarks:";
+        for (const auto &benchmark : BENCHMARKS) {
+            std::cerr << " " << benchmark.name;
+        }
+        std::cerr << std::endl;
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> selected;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--rom") == 0 && i + 1 < argc) {
+            options.rom = argv[++i];
+        } else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            options.instances = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            options.cycles = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            options.steps = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.minTime = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            options.repetitions = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--json") == 0) {
+            options.json = true;
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            selected.emplace_back(argv[i]);
+        }
+    }
+
+    RomStore store;
+    if (options.rom != nullptr) {
+        options.image = store.load(options.rom);
+        if (options.image == nullptr || options.image->size > vCPU::MEMORY - vCPU::START_ADDRESS) {
+            std::cerr << "Failed to load ROM: " << options.rom << std::endl;
+            return 1;
+        }
+    }
+
+    Reporter reporter(options);
+    for (const auto &benchmark : BENCHMARKS) {
+        if (selected.empty() || std::find(selected.begin(), selected.end(), benchmark.name) != selected.end()) {
+            benchmark.run(options, reporter);
+        }
+    }
+    reporter.finish();
+}
@@ -0,0 +1,351 @@
+#include "BlockEngine.h"
+#include "Hash.h"
+#include "RomDatabase.h"
+#include "RomStore.h"
+#include "ThreadPool.h"
+#include "vCPU.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs a corpus of ROMs with scripted input and checks display hashes against golden files.
+// Usage: chip8-conformance <corpus> [--golden dir] [--update] [--engine interp|block] [--romdb file] [--threads N]
+
+namespace {
+    struct Options {
+        std::filesystem::path golden;
+        bool update = false;
+        bool blockEngine = false;
+        const char *romdbPath = RomDatabase::DEFAULT_PATH;
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    struct KeyChange {
+        uint64_t frame; // Keys take effect at the start of this frame.
+        uint16_t keys; // Bit i set while key i is down.
+    };
+
+    // One corpus line: a ROM and how to run it.
+    struct Entry {
+        std::string line; // As written, for messages.
+        std::string rom;
+        Profile profile = Profile::Modern;
+        bool profileSet = false;
+        uint64_t frames = 600;
+        uint64_t every = 1; // Hash the display after every this many frames.
+        unsigned int ipf = 10;
+        uint64_t seed = 0;
+        std::vector<KeyChange> keys;
+    };
+
+    enum class Status { Pass, Fail, New, Updated, Error };
+
+    struct Result {
+        Status status = Status::Error;
+        std::string message;
+        std::vector<uint64_t> hashes;
+        double seconds = 0;
+    };
+
+    void usage() {
+        std::cerr << "Usage: chip8-conformance <corpus> [--golden dir] [--update] [--engine interp|block] [--romdb file] [--threads N]" << std::endl;
+        std::cerr << "  Each corpus line is: rom [profile=P] [frames=N] [every=N] [ipf=N] [seed=N] [keys=F:MASK,...]" << std::endl;
+        std::cerr << "  with ROM paths relative to the corpus file and key masks in hex, pressed from frame F on." << std::endl;
+        std::cerr << "  --golden D  Directory of golden files (default: golden/ next to the corpus)." << std::endl;
+        std::cerr << "  --update    Write golden files for entries that have none or no longer match." << std::endl;
+        std::cerr << "  --engine E  Run modern entries on interp (default) or block, other profiles always interpret." << std::endl;
+    }
+
+    std::string hex16(const uint64_t value) {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llX", static_cast<unsigned long long>(value));
+        return text;
+    }
+
+    bool parseEntry(const std::string &line, const std::filesystem::path &base, Entry &entry) {
+        std::istringstream words(line);
+        std::string word;
+        if (!(words >> word)) {
+            return false;
+        }
+        entry.line = line;
+        entry.rom = (base / word).string();
+
+        while (words >> word) {
+            const size_t equals = word.find('=');
+            if (equals == std::string::npos) {
+                return false;
+            }
+            const std::string key = word.substr(0, equals);
+            const std::string value = word.substr(equals + 1);
+            char *end = nullptr;
+            if (key == "profile") {
+                if (!parseProfile(value.c_str(), entry.profile)) {
+                    return false;
+                }
+                entry.profileSet = true;
+                continue;
+            }
+            if (key == "keys") {
+                for (size_t at = 0; at < value.size();) {
+                    const uint64_t frame = std::strtoull(value.c_str() + at, &end, 10);
+                    if (*end != ':') {
+                        return false;
+                    }
+                    const auto keys = static_cast<uint16_t>(std::strtoul(end + 1, &end, 16));
+                    entry.keys.push_back({frame, keys});
+                    at = static_cast<size_t>(end - value.c_str());
+                    if (*end == ',') {
+                        ++at;
+                    } else if (*end != '\0') {
+                        return false;
+                    }
+                }
+                std::stable_sort(entry.keys.begin(), entry.keys.end(),
+                                 [](const KeyChange &a, const KeyChange &b) { return a.frame < b.frame; });
+                continue;
+            }
+
+            const uint64_t number = std::strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                return false;
+            }
+            if (key == "frames") {
+                entry.frames = number;
+            } else if (key == "every" && number > 0) {
+                entry.every = number;
+            } else if (key == "ipf" && number > 0) {
+                entry.ipf = static_cast<unsigned int>(number);
+            } else if (key == "seed") {
+                entry.seed = number;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Golden files are named by everything that decides the hashes: the ROM contents and the run settings.
+    std::filesystem::path goldenPath(const Options &options, const Entry &entry, const uint64_t romHash) {
+        std::ostringstream key;
+        key << hex16(romHash) << " " << profileName(entry.profile) << " " << entry.frames << " " << entry.every
+                << " " << entry.ipf << " " << entry.seed;
+        for (const auto &change : entry.keys) {
+            key << " " << change.frame << ":" << change.keys;
+        }
+        const std::string text = key.str();
+        return options.golden / (hex16(hash64(text.data(), text.size())) + ".golden");
+    }
+
+    // Run frame by frame, applying key changes as their frame starts and hashing the display (and resolution)
+    // after every `every` frames.
+    template <typename CPU, typename Run>
+    void play(CPU &cpu, Run run, const Entry &entry, std::vector<uint64_t> &hashes) {
+        size_t next = 0;
+        for (uint64_t frame = 0; frame < entry.frames; ++frame) {
+            for (; next < entry.keys.size() && entry.keys[next].frame <= frame; ++next) {
+                for (unsigned int k = 0; k < 16; ++k) {
+                    cpu.keypad[k] = entry.keys[next].keys >> k & 1u;
+                }
+            }
+            run(entry.ipf);
+            if ((frame + 1) % entry.every == 0) {
+                hashes.push_back(hash64(cpu.video, sizeof(cpu.video), cpu.hires));
+            }
+        }
+    }
+
+    Result check(const Options &options, const Entry &entry, const RomImage &rom) {
+        Result result;
+        const auto start = std::chrono::steady_clock::now();
+
+        const auto interpret = [&]<typename CPU>() {
+            const auto cpu = std::make_unique<CPU>(entry.seed);
+            if (!cpu->loadROM(rom.data, rom.size)) {
+                return false;
+            }
+            cpu->cyclesPerFrame = entry.ipf;
+            if (entry.profile == Profile::Modern && options.blockEngine) {
+                if constexpr (std::is_same_v<CPU, vCPU>) {
+                    BlockEngine engine(*cpu);
+                    play(*cpu, [&](const unsigned long long n) { engine.run(n); }, entry, result.hashes);
+                }
+            } else {
+                play(*cpu, [&](const unsigned long long n) { cpu->run(n); }, entry, result.hashes);
+            }
+            return true;
+        };
+        bool loaded = false;
+        switch (entry.profile) {
+            case Profile::Modern: loaded = interpret.operator()<vCPU>(); break;
+            case Profile::Vip: loaded = interpret.operator()<BasicCPU<Chip8, VipQuirks>>(); break;
+            case Profile::Chip48: loaded = interpret.operator()<BasicCPU<Chip8, Chip48Quirks>>(); break;
+            case Profile::SuperChip: loaded = interpret.operator()<BasicCPU<SuperChip>>(); break;
+            case Profile::XoChip: loaded = interpret.operator()<BasicCPU<XoChip>>(); break;
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!loaded) {
+            result.message = "ROM too large for " + std::string(profileName(entry.profile));
+            return result;
+        }
+
+        // Golden file: a comment line naming the entry, then one hash per checked frame.
+        const std::filesystem::path path = goldenPath(options, entry, rom.hash);
+        std::vector<uint64_t> golden;
+        bool exists = false;
+        if (std::ifstream file(path); file.is_open()) {
+            exists = true;
+            std::string line;
+            while (std::getline(file, line)) {
+                if (!line.empty() && line[0] != '#') {
+                    golden.push_back(std::strtoull(line.c_str(), nullptr, 16));
+                }
+            }
+        }
+
+        if (exists && golden == result.hashes) {
+            result.status = Status::Pass;
+            return result;
+        }
+        if (exists) {
+            const size_t frames = std::min(golden.size(), result.hashes.size());
+            const size_t differs = std::mismatch(golden.begin(), golden.begin() + frames, result.hashes.begin()).first -
+                                   golden.begin();
+            result.message = "first differs at frame " + std::to_string((differs + 1) * entry.every);
+        }
+        if (!options.update) {
+            result.status = exists ? Status::Fail : Status::New;
+            if (!exists) {
+                result.message = "no golden file, run with --update";
+            }
+            return result;
+        }
+
+        std::ofstream file(path);
+        file << "# " << entry.line << "\n";
+        for (const uint64_t hash : result.hashes) {
+            file << hex16(hash) << "\n";
+        }
+        if (!file.good()) {
+            result.message = "failed to write " + path.string();
+            return result;
+        }
+        result.status = exists ? Status::Updated : Status::New;
+        return result;
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 1;
+    }
+    const std::filesystem::path corpusPath = argv[1];
+    Options options;
+    options.golden = corpusPath.parent_path() / "golden";
+
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+            options.golden = argv[++i];
+        } else if (std::strcmp(argv[i], "--update") == 0) {
+            options.update = true;
+        } else if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "block") == 0) {
+                options.blockEngine = true;
+            } else if (std::strcmp(argv[i], "interp") != 0) {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--romdb") == 0 && i + 1 < argc) {
+            options.romdbPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    std::ifstream corpus(corpusPath);
+    if (!corpus.is_open()) {
+        std::cerr << "Failed to open corpus: " << corpusPath.string() << std::endl;
+        return 1;
+    }
+
+    // Every ROM is loaded up front, so the runs share the store read-only.
+    RomStore store;
+    RomDatabase database;
+    database.load(options.romdbPath);
+    std::vector<Entry> entries;
+    std::vector<const RomImage *> roms;
+    std::string line;
+    for (unsigned int number = 1; std::getline(corpus, line); ++number) {
+        if (const size_t comment = line.find('#'); comment != std::string::npos) {
+            line.erase(comment);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        Entry entry;
+        if (!parseEntry(line, corpusPath.parent_path(), entry)) {
+            std::cerr << corpusPath.string() << ":" << number << ": bad entry" << std::endl;
+            return 1;
+        }
+        const RomImage *rom = store.load(entry.rom);
+        if (rom == nullptr) {
+            std::cerr << "Failed to load ROM: " << entry.rom << std::endl;
+            return 1;
+        }
+        if (!entry.profileSet) {
+            entry.profile = database.lookup(rom->hash);
+        }
+        entries.push_back(std::move(entry));
+        roms.push_back(rom);
+    }
+    if (options.update) {
+        std::filesystem::create_directories(options.golden);
+    }
+
+    std::vector<Result> results(entries.size());
+    const auto start = std::chrono::steady_clock::now();
+    ThreadPool pool(options.threads);
+    pool.parallelFor(entries.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t e = begin; e < end; ++e) {
+            results[e] = check(options, entries[e], *roms[e]);
+        }
+    });
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    constexpr const char *STATUS[] = {"PASS", "FAIL", "NEW", "UPDATED", "ERROR"};
+    unsigned int counts[std::size(STATUS)]{};
+    for (size_t e = 0; e < entries.size(); ++e) {
+        const Result &result = results[e];
+        ++counts[static_cast<unsigned int>(result.status)];
+        std::cout << STATUS[static_cast<unsigned int>(result.status)] << " " << entries[e].rom << " "
+                << profileName(entries[e].profile) << " " << result.hashes.size() << " hashes "
+                << static_cast<int>(result.seconds * 1000) << "ms";
+        if (!result.message.empty()) {
+            std::cout << " (" << result.message << ")";
+        }
+        std::cout << "\n";
+    }
+    std::cout << counts[0] << " passed, " << counts[1] << " failed, " << counts[2] << " new, " << counts[3]
+            << " updated, " << counts[4] << " errors in " << elapsed.count() << "s" << std::endl;
+
+    // Without --update, entries with no golden file count against the run too.
+    const bool failed = counts[1] > 0 || counts[4] > 0 || (!options.update && counts[2] > 0);
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,329 @@
+#include "BlockEngine.h"
+#include "Movie.h"
+#include "RomDatabase.h"
+#include "RomStore.h"
+#include "Tone.h"
+#include "vCPU.h"
+
+#ifdef CHIP8_PROFILE
+#include "Profiler.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+
+// Runs a ROM with no window for a fixed number of cycles (or frames) and dumps the final machine state.
+// Usage: chip8-headless <rom> [--cycles N | --frames N] [--ipf N] [--profile P] [--romdb file] [--engine interp|block] [--verify] [--seed N] [--replay movie] [--wav file]
+
+namespace {
+    void usage() {
+        std::cerr << "Usage: chip8-headless <rom> [--cycles N | --frames N] [--ipf N] [--profile P] [--romdb file] [--engine interp|block] [--verify] [--seed N] [--replay movie] [--wav file]" << std::endl;
+        std::cerr << "  --cycles N  Run N instructions." << std::endl;
+        std::cerr << "  --frames N  Run N frames of --ipf instructions each." << std::endl;
+        std::cerr << "  --ipf N     Instructions per 60Hz frame (default 10, i.e. 600Hz), timers tick once per frame." << std::endl;
+        std::cerr << "  --profile P Machine and quirks: modern, vip, chip48, schip or xochip. Default: from the ROM database, else modern." << std::endl;
+        std::cerr << "              The block engine, --verify and --replay need modern." << std::endl;
+        std::cerr << "  --romdb F   ROM database to look the profile up in (default " << RomDatabase::DEFAULT_PATH << ")." << std::endl;
+        std::cerr << "  --engine E  Execution engine, interp (default) or block." << std::endl;
+        std::cerr << "  --verify    Run the interpreter and block engine in lockstep, report the first mismatch." << std::endl;
+        std::cerr << "  --seed N    Random seed (default 0), runs with the same seed are identical." << std::endl;
+        std::cerr << "  --replay M  Replay a recorded movie as fast as possible, checking every frame hash." << std::endl;
+        std::cerr << "  --wav F     Write the sound timer's tone to a WAV file, one 60Hz frame of samples per frame." << std::endl;
+#ifdef CHIP8_PROFILE
+        std::cerr << "  --prof-out P  Write the profile to P.txt and P.csv (default chip8-profile)." << std::endl;
+#endif
+    }
+
+#ifdef CHIP8_PROFILE
+    const char *profilePrefix = "chip8-profile";
+
+    void writeProfile(const Profiler &profiler, const uint8_t *memory, const uint64_t endCycle) {
+        if (profiler.write(profilePrefix, memory, endCycle)) {
+            std::cerr << "Profile written to " << profilePrefix << ".txt and " << profilePrefix << ".csv" << std::endl;
+        } else {
+            std::cerr << "Failed to write profile " << profilePrefix << std::endl;
+        }
+    }
+#endif
+
+    template <typename CPU>
+    void dumpState(const CPU &cpu) {
+        std::cout << std::hex << std::uppercase;
+        for (unsigned int i = 0; i < 16; ++i) {
+            std::cout << "V" << i << "=" << static_cast<int>(cpu.registers[i]) << (i % 8 == 7 ? "\n" : " ");
+        }
+        std::cout << "I=" << cpu.index << " PC=" << cpu.pc << " SP=" << static_cast<int>(cpu.sp)
+                << " DT=" << static_cast<int>(cpu.delayTimer()) << " ST=" << static_cast<int>(cpu.soundTimer()) << "\n";
+        std::cout << "Stack:";
+        for (unsigned int i = 0; i < cpu.sp && i < 16; ++i) {
+            std::cout << " " << cpu.stack[i];
+        }
+        std::cout << std::dec << "\n";
+
+        // One character per pixel, by the planes it is lit on.
+        for (unsigned int y = 0; y < CPU::HEIGHT; ++y) {
+            for (unsigned int x = 0; x < CPU::WIDTH; ++x) {
+                std::cout << ".#+@"[cpu.pixel(x, y)];
+            }
+            std::cout << "\n";
+        }
+        std::cout.flush();
+    }
+
+    // Run for cycles instructions through run, optionally writing the tone to a WAV file, then dump the state.
+    template <typename CPU, typename Run>
+    int runAndDump(CPU &cpu, Run run, const unsigned long long cycles, const unsigned long long ipf,
+                   const char *wavPath) {
+        WavWriter wav;
+        if (wavPath != nullptr && !wav.open(wavPath, ToneGenerator::SAMPLE_RATE)) {
+            std::cerr << "Failed to open file: " << wavPath << std::endl;
+            return 1;
+        }
+
+        // With audio the run goes frame by frame, the tone is gated on the sound timer at each frame's end.
+        ToneGenerator tone;
+        int16_t samples[ToneGenerator::SAMPLE_RATE / 60];
+        double fillSeconds = 0;
+        double worstFill = 0;
+
+#ifdef CHIP8_PROFILE
+        Profiler profiler(CPU::MEMORY, cpu.cyclesPerFrame, cpu.cycleCount);
+        cpu.profiler = &profiler;
+#endif
+
+        const auto start = std::chrono::steady_clock::now();
+        if (wavPath == nullptr) {
+            run(cycles);
+        } else {
+            for (unsigned long long done = 0; done < cycles; done += ipf) {
+                run(std::min(ipf, cycles - done));
+
+                const auto fillStart = std::chrono::steady_clock::now();
+                if (cpu.customAudio) {
+                    tone.setPattern(cpu.audioPattern, cpu.pitch);
+                }
+                tone.setGate(cpu.soundTimer() > 0);
+                tone.fill(samples, std::size(samples));
+                const double fill = std::chrono::duration<double>(std::chrono::steady_clock::now() - fillStart).count();
+                fillSeconds += fill;
+                worstFill = std::max(worstFill, fill);
+
+                wav.write(samples, std::size(samples));
+            }
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        dumpState(cpu);
+
+#ifdef CHIP8_PROFILE
+        cpu.profiler = nullptr;
+        writeProfile(profiler, cpu.memory, cpu.cycleCount);
+#endif
+
+        if (wavPath != nullptr) {
+            const size_t buffers = wav.samplesWritten() / std::size(samples);
+            std::cerr << "Audio: " << wav.samplesWritten() << " samples in " << buffers << " buffers, fill avg/max "
+                    << (buffers > 0 ? fillSeconds / buffers * 1e6 : 0) << "/" << worstFill * 1e6 << "us" << std::endl;
+            wav.close();
+        }
+
+        std::cerr << "Cycles: " << cycles << " Time: " << elapsed.count() << "s";
+        if (elapsed.count() > 0) {
+            std::cerr << " (" << static_cast<double>(cycles) / elapsed.count() << " cycles/s)";
+        }
+        std::cerr << std::endl;
+        return 0;
+    }
+}
+
+int main(const int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    const char *romPath = argv[1];
+    unsigned long long cycles = 0;
+    unsigned long long frames = 60;
+    unsigned long long ipf = 10;
+    bool useCycles = false;
+    bool blockEngine = false;
+    bool verify = false;
+    uint64_t seed = 0;
+    const char *replayPath = nullptr;
+    const char *wavPath = nullptr;
+    Profile profile = Profile::Modern;
+    bool profileSet = false;
+    const char *romdbPath = RomDatabase::DEFAULT_PATH;
+
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) {
+            cycles = std::strtoull(argv[++i], nullptr, 10);
+            useCycles = true;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::strtoull(argv[++i], nullptr, 10);
+            useCycles = false;
+        } else if (std::strcmp(argv[i], "--ipf") == 0 && i + 1 < argc) {
+            // vCPU::cyclesPerFrame is an unsigned int and must not be 0.
+            ipf = std::clamp(std::strtoull(argv[++i], nullptr, 10), 1ull,
+                             static_cast<unsigned long long>(std::numeric_limits<unsigned int>::max()));
+        } else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            if (!parseProfile(argv[++i], profile)) {
+                usage();
+                return 1;
+            }
+            profileSet = true;
+        } else if (std::strcmp(argv[i], "--romdb") == 0 && i + 1 < argc) {
+            romdbPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            ++i;
+            if (std::strcmp(argv[i], "block") == 0) {
+                blockEngine = true;
+            } else if (std::strcmp(argv[i], "interp") != 0) {
+                usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--wav") == 0 && i + 1 < argc) {
+            wavPath = argv[++i];
+#ifdef CHIP8_PROFILE
+        } else if (std::strcmp(argv[i], "--prof-out") == 0 && i + 1 < argc) {
+            profilePrefix = argv[++i];
+#endif
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (!useCycles) {
+        cycles = frames * ipf;
+    }
+
+    RomStore store;
+    const RomImage *rom = store.load(romPath);
+    if (rom == nullptr) {
+        std::cerr << "Failed to load ROM: " << romPath << std::endl;
+        return 1;
+    }
+
+    if (!profileSet) {
+        RomDatabase database;
+        database.load(romdbPath);
+        profile = database.lookup(rom->hash);
+    }
+
+    std::cerr << "ROM " << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << rom->hash
+            << std::dec << std::setfill(' ') << " profile " << profileName(profile) << std::endl;
+
+    const auto tooLarge = [&](const size_t memory) {
+        std::cerr << "ROM is " << rom->size << " bytes, " << profileName(profile) << " has room for "
+                << memory - vCPU::START_ADDRESS << "." << std::endl;
+        return 1;
+    };
+
+    // Other profiles are separate instantiations with only the interpreter behind them.
+    if (profile != Profile::Modern) {
+        if (blockEngine || verify || replayPath != nullptr) {
+            std::cerr << "--engine block, --verify and --replay need the modern profile." << std::endl;
+            return 1;
+        }
+
+        const auto runInterpreted = [&]<typename CPU>() {
+            const auto other = std::make_unique<CPU>(seed);
+            if (!other->loadROM(rom->data, rom->size)) {
+                return tooLarge(CPU::MEMORY);
+            }
+            other->cyclesPerFrame = static_cast<unsigned int>(ipf);
+            return runAndDump(*other, [&](const unsigned long long n) { other->run(n); }, cycles, ipf, wavPath);
+        };
+        switch (profile) {
+            case Profile::Vip: return runInterpreted.operator()<BasicCPU<Chip8, VipQuirks>>();
+            case Profile::Chip48: return runInterpreted.operator()<BasicCPU<Chip8, Chip48Quirks>>();
+            case Profile::SuperChip: return runInterpreted.operator()<BasicCPU<SuperChip>>();
+            case Profile::XoChip: return runInterpreted.operator()<BasicCPU<XoChip>>();
+            case Profile::Modern: break;
+        }
+    }
+
+    vCPU cpu(seed);
+    if (!cpu.loadROM(rom->data, rom->size)) {
+        return tooLarge(vCPU::MEMORY);
+    }
+    cpu.cyclesPerFrame = static_cast<unsigned int>(ipf);
+
+    if (replayPath != nullptr) {
+        Movie movie;
+        if (!movie.load(replayPath)) {
+            std::cerr << "Failed to load movie: " << replayPath << std::endl;
+            return 1;
+        }
+
+        BlockEngine engine(cpu);
+#ifdef CHIP8_PROFILE
+        Profiler profiler(vCPU::MEMORY, cpu.cyclesPerFrame, cpu.cycleCount);
+        cpu.profiler = &profiler;
+#endif
+        const auto start = std::chrono::steady_clock::now();
+        const Movie::Result result = movie.replay(cpu, [&](const unsigned long long n) {
+            if (blockEngine) {
+                engine.run(n);
+            } else {
+                cpu.run(n);
+            }
+        });
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+#ifdef CHIP8_PROFILE
+        cpu.profiler = nullptr;
+        writeProfile(profiler, cpu.memory, cpu.cycleCount);
+#endif
+
+        if (!result.romMatches) {
+            std::cout << "Warning: ROM differs from the one recorded." << std::endl;
+        }
+        if (result.mismatchFrame != UINT64_MAX) {
+            std::cout << "Mismatch at frame " << result.mismatchFrame << " (cycle " << cpu.cycleCount << ")" << std::endl;
+        } else {
+            std::cout << "Replayed " << result.frames << " frames, every frame hash matches." << std::endl;
+        }
+        std::cerr << "Cycles: " << cpu.cycleCount << " Time: " << elapsed.count() << "s";
+        if (elapsed.count() > 0) {
+            std::cerr << " (" << static_cast<double>(cpu.cycleCount) / elapsed.count() << " cycles/s)";
+        }
+        std::cerr << std::endl;
+        return result.mismatchFrame != UINT64_MAX ? 2 : 0;
+    }
+
+    if (verify) {
+        BlockEngine::Mismatch mismatch;
+        if (BlockEngine::verify(cpu, cycles, mismatch)) {
+            std::cout << "Verified " << cycles << " cycles, interpreter and block engine agree." << std::endl;
+            return 0;
+        }
+        std::cout << "Mismatch after " << mismatch.cycle << " cycles in block at " << std::hex << std::uppercase
+                << mismatch.pc << std::dec << ": " << mismatch.field << " expected " << mismatch.expected
+                << " got " << mismatch.actual << std::endl;
+        return 2;
+    }
+
+    BlockEngine engine(cpu);
+    return runAndDump(cpu, [&](const unsigned long long n) {
+        if (blockEngine) {
+            engine.run(n);
+        } else {
+            cpu.run(n);
+        }
+    }, cycles, ipf, wavPath);
+}